@@ -0,0 +1,150 @@
+#include "axismodel.h"
+#include "profile.h"
+#include <cmath>
+#include <ahp_gt.h>
+
+AxisModel AxisModel::fromLibrary(int axis)
+{
+    AxisModel m;
+    m.divider = ahp_gt_get_divider(axis);
+    m.multiplier = ahp_gt_get_multiplier(axis);
+    m.wormsteps = ahp_gt_get_wormsteps(axis);
+    m.totalsteps = ahp_gt_get_totalsteps(axis);
+    m.microsteps = m.totalsteps * m.divider / m.multiplier;
+    m.tracking_frequency = m.microsteps / SIDEREAL_DAY;
+    m.seconds_per_turn = SIDEREAL_DAY / (ahp_gt_get_crown_teeth(axis) * ahp_gt_get_worm_teeth(axis) / ahp_gt_get_motor_teeth(axis));
+    m.goto_frequency = m.microsteps * ahp_gt_get_max_speed(axis) / M_PI / 2;
+    m.max_speed = ahp_gt_get_max_speed(axis) * SIDEREAL_DAY / M_PI / 2;
+    m.acceleration = ahp_gt_get_acceleration_angle(axis) * 180.0 / M_PI;
+    return m;
+}
+
+AxisView AxisView::fromLibrary(int axis)
+{
+    AxisView v;
+    v.model = AxisModel::fromLibrary(axis);
+    v.motor_steps = ahp_gt_get_motor_steps(axis);
+    v.motor_teeth = ahp_gt_get_motor_teeth(axis);
+    v.worm_teeth = ahp_gt_get_worm_teeth(axis);
+    v.crown_teeth = ahp_gt_get_crown_teeth(axis);
+    v.acceleration = ahp_gt_get_acceleration_angle(axis);
+    v.stepping_conf = ahp_gt_get_stepping_conf(axis);
+    v.stepping_mode = ahp_gt_get_stepping_mode(axis);
+    v.direction_invert = ahp_gt_get_direction_invert(axis);
+    v.feature = ahp_gt_get_feature(axis);
+    v.motor_pwm = 0.0;
+    v.timing = 0;
+    return v;
+}
+
+MountView MountView::fromLibrary()
+{
+    MountView v;
+    //both axes are always set to the same frequency
+    v.pwm_frequency = ahp_gt_get_pwm_frequency(0);
+    v.mount_type = ahp_gt_get_mount_type();
+    int flags = ahp_gt_get_mount_flags();
+    v.mount_style = 0;
+    v.mount_style |= ((ahp_gt_get_features(0) & isAZEQ) != 0) ? 2 : 0;
+    v.mount_style |= ((ahp_gt_get_features(1) & isAZEQ) != 0) ? 2 : 0;
+    if(!v.mount_style)
+        v.mount_style |= ((flags & isForkMount) != 0) ? 1 : 0;
+    v.high_bauds = (flags & bauds_115200) != 0;
+    return v;
+}
+
+int ViewModel::update(int axis, const AxisView &v)
+{
+    int changed = AllAxisFields;
+    if(axisValid[axis])
+    {
+        const AxisView &o = axes[axis];
+        changed = 0;
+        if(v.model.divider != o.model.divider || v.model.multiplier != o.model.multiplier ||
+                v.model.wormsteps != o.model.wormsteps || v.model.totalsteps != o.model.totalsteps)
+            changed |= GearingField;
+        if(v.model.tracking_frequency != o.model.tracking_frequency || v.model.seconds_per_turn != o.model.seconds_per_turn ||
+                v.model.goto_frequency != o.model.goto_frequency)
+            changed |= FrequencyField;
+        if(v.motor_pwm != o.motor_pwm)
+            changed |= MotorPwmField;
+        if(v.motor_steps != o.motor_steps)
+            changed |= MotorStepsField;
+        if(v.motor_teeth != o.motor_teeth)
+            changed |= MotorTeethField;
+        if(v.worm_teeth != o.worm_teeth)
+            changed |= WormTeethField;
+        if(v.crown_teeth != o.crown_teeth)
+            changed |= CrownTeethField;
+        if(v.acceleration != o.acceleration)
+            changed |= AccelerationField;
+        if(v.model.max_speed != o.model.max_speed)
+            changed |= MaxSpeedField;
+        if(v.stepping_conf != o.stepping_conf)
+            changed |= CoilField;
+        if(v.stepping_mode != o.stepping_mode)
+            changed |= SteppingModeField;
+        if(v.direction_invert != o.direction_invert)
+            changed |= InvertField;
+        if(v.feature != o.feature)
+            changed |= GpioField;
+        if(v.timing != o.timing)
+            changed |= TimingField;
+    }
+    axes[axis] = v;
+    axisValid[axis] = true;
+    account(changed, AllAxisFields);
+    return changed;
+}
+
+int ViewModel::update(const MountView &v)
+{
+    int changed = AllMountFields;
+    if(mountValid)
+    {
+        changed = 0;
+        if(v.pwm_frequency != mount.pwm_frequency)
+            changed |= PwmFrequencyField;
+        if(v.mount_type != mount.mount_type)
+            changed |= MountTypeField;
+        if(v.mount_style != mount.mount_style)
+            changed |= MountStyleField;
+        if(v.high_bauds != mount.high_bauds)
+            changed |= HighBaudsField;
+    }
+    mount = v;
+    mountValid = true;
+    account(changed, AllMountFields);
+    return changed;
+}
+
+void ViewModel::invalidate()
+{
+    axisValid[0] = false;
+    axisValid[1] = false;
+    mountValid = false;
+}
+
+void ViewModel::account(int changed, int all)
+{
+    int fields = qPopulationCount((quint32)all);
+    int count = qPopulationCount((quint32)changed);
+    counters.refreshes++;
+    counters.changed += count;
+    counters.unchanged += fields - count;
+}
+
+double motorPwmFrequency(int inductance, int resistance, int current, int voltage)
+{
+    double L = (double)inductance / 1000000.0;
+    double R = (double)resistance / 1000.0;
+    double mI = (double)current / 1000.0;
+    double mV = (double)voltage;
+    double Z = sqrt(fmax(0, pow(mV / mI, 2.0) - pow(R, 2.0)));
+    return (2.0 * M_PI * Z / L);
+}
+
+double controllerPwmFrequency(int value)
+{
+    return 366 + 366 * value;
+}
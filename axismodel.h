@@ -0,0 +1,137 @@
+#ifndef AXISMODEL_H
+#define AXISMODEL_H
+
+#include <QtGlobal>
+#include <QtAlgorithms>
+
+///Quantities derived from the gear train and speed settings of one axis
+struct AxisModel
+{
+    double divider;
+    double multiplier;
+    double wormsteps;
+    double totalsteps;
+    ///Microsteps per revolution of the axis as driven by the controller
+    double microsteps;
+    ///Step rate at sidereal speed
+    double tracking_frequency;
+    ///Seconds per motor turn at sidereal speed
+    double seconds_per_turn;
+    ///Step rate at maximum speed
+    double goto_frequency;
+    ///Maximum speed as a multiple of sidereal
+    double max_speed;
+    ///Acceleration ramp, degrees
+    double acceleration;
+
+    ///Read axis settings from the library and derive the rest
+    static AxisModel fromLibrary(int axis);
+};
+
+///What the controls of one axis show: the library settings plus the values the
+///window derives from its own inputs
+struct AxisView
+{
+    AxisModel model;
+    int motor_steps;
+    int motor_teeth;
+    int worm_teeth;
+    int crown_teeth;
+    ///Acceleration ramp, radians
+    double acceleration;
+    int stepping_conf;
+    int stepping_mode;
+    int direction_invert;
+    int feature;
+    ///Chopper frequency of the motor winding, filled by the window
+    double motor_pwm;
+    ///Timing setting, filled by the window
+    int timing;
+
+    ///Read axis settings from the library, motor_pwm and timing are left at 0
+    static AxisView fromLibrary(int axis);
+};
+
+///What the mount-wide controls show
+struct MountView
+{
+    int pwm_frequency;
+    int mount_type;
+    ///0 equatorial, 1 fork, 2 AZ/EQ
+    int mount_style;
+    bool high_bauds;
+
+    static MountView fromLibrary();
+};
+
+///Keeps the views last rendered by the window. update() stores the new view and
+///returns the fields that differ from the previous one, so that a refresh only
+///touches the widgets that have something new to show.
+class ViewModel
+{
+    public:
+        enum AxisField
+        {
+            ///divider, multiplier, worm steps and total steps
+            GearingField = 1 << 0,
+            ///tracking and goto step rates, seconds per turn
+            FrequencyField = 1 << 1,
+            MotorPwmField = 1 << 2,
+            MotorStepsField = 1 << 3,
+            MotorTeethField = 1 << 4,
+            WormTeethField = 1 << 5,
+            CrownTeethField = 1 << 6,
+            AccelerationField = 1 << 7,
+            MaxSpeedField = 1 << 8,
+            CoilField = 1 << 9,
+            SteppingModeField = 1 << 10,
+            InvertField = 1 << 11,
+            GpioField = 1 << 12,
+            TimingField = 1 << 13,
+            AllAxisFields = (1 << 14) - 1,
+        };
+        enum MountField
+        {
+            PwmFrequencyField = 1 << 0,
+            MountTypeField = 1 << 1,
+            MountStyleField = 1 << 2,
+            HighBaudsField = 1 << 3,
+            AllMountFields = (1 << 4) - 1,
+        };
+        struct Stats
+        {
+            quint64 refreshes { 0 };
+            ///fields rendered again
+            quint64 changed { 0 };
+            ///fields left alone
+            quint64 unchanged { 0 };
+        };
+
+        ///Store view as rendered for axis, returns the AxisField flags that changed
+        int update(int axis, const AxisView &view);
+        ///Store view as rendered, returns the MountField flags that changed
+        int update(const MountView &view);
+        ///Render everything on the next update, after connecting or loading a profile
+        void invalidate();
+        Stats stats() const
+        {
+            return counters;
+        }
+
+    private:
+        void account(int changed, int all);
+
+        AxisView axes[2];
+        MountView mount;
+        bool axisValid[2] { false, false };
+        bool mountValid { false };
+        Stats counters;
+};
+
+///Chopper frequency matching the electrical time constant of a motor winding
+///inductance in uH, resistance in mOhm, current in mA, voltage in V
+double motorPwmFrequency(int inductance, int resistance, int current, int voltage);
+///Controller PWM frequency in Hz of a PWMFreq setting
+double controllerPwmFrequency(int value);
+
+#endif // AXISMODEL_H
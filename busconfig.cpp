@@ -0,0 +1,95 @@
+#include "busconfig.h"
+#include "trace.h"
+#include <QElapsedTimer>
+
+BusConfigurator::BusConfigurator(DifferentialWriter *w)
+{
+    writer = w;
+}
+
+void BusConfigurator::setRange(int first, int last, Profile profile)
+{
+    for(int address = first; address <= last; address++)
+        setProfile(address, profile);
+}
+
+void BusConfigurator::setProfile(int address, Profile profile)
+{
+    profile.address = address;
+    profiles.insert(address, profile);
+}
+
+BusConfigurator::Report BusConfigurator::run(int *percent, int *finished, bool force)
+{
+    TRACE_SCOPE("bus configuration");
+    Report report;
+    QElapsedTimer timer;
+    timer.start();
+    int selected = ahp_gt_get_current_device();
+    //everything is staged in the library before the first byte goes out
+    QMap<int, DeviceImage> expected;
+    for(Profile profile : profiles)
+    {
+        ahp_gt_select_device(profile.address);
+        profile.apply();
+        expected.insert(profile.address, DeviceImage::capture());
+    }
+    int done = 0;
+    for(int address : expected.keys())
+    {
+        DeviceReport device;
+        device.address = address;
+        ahp_gt_select_device(address);
+        QElapsedTimer step;
+        step.start();
+        DifferentialWriter::Summary summary = writer->write(nullptr, nullptr, force);
+        device.write_ms = step.nsecsElapsed() / 1000000.0;
+        device.axesWritten = summary.axesWritten;
+        device.axesSkipped = summary.axesSkipped;
+        //read back even when nothing was written, the shadow may not match the controller
+        if(verify)
+        {
+            step.restart();
+            ahp_gt_read_values(0);
+            ahp_gt_read_values(1);
+            DeviceImage actual = DeviceImage::capture();
+            for(int a = 0; a < 2; a++)
+            {
+                for(QString name : expected[address].diff(actual, a))
+                    device.mismatches.append(QString("%1:%2").arg(a).arg(name));
+            }
+            device.mismatches.removeDuplicates();
+            device.verified = device.mismatches.isEmpty();
+            //the shadow holds what the controller really has, a mismatch is written again next time
+            writer->recordRead();
+            device.verify_ms = step.nsecsElapsed() / 1000000.0;
+            report.failed += !device.verified;
+        }
+        report.devices.append(device);
+        done++;
+        if(percent)
+            *percent = done * 100 / expected.count();
+    }
+    ahp_gt_select_device(selected);
+    if(finished)
+        *finished = 1;
+    report.elapsed_ms = timer.nsecsElapsed() / 1000000.0;
+    return report;
+}
+
+QString BusConfigurator::Report::text() const
+{
+    QStringList lines;
+    for(DeviceReport device : devices)
+    {
+        QString line = QString("address %1: %2 axes written, %3 skipped in %4 ms").arg(device.address).arg(device.axesWritten)
+                       .arg(device.axesSkipped).arg(device.write_ms, 0, 'f', 0);
+        if(device.verified)
+            line += QString(", verified in %1 ms").arg(device.verify_ms, 0, 'f', 0);
+        else if(!device.mismatches.isEmpty())
+            line += ", differs in " + device.mismatches.join(" ");
+        lines.append(line);
+    }
+    lines.append(QString("%1 addresses in %2 ms, %3 failed").arg(devices.count()).arg(elapsed_ms, 0, 'f', 0).arg(failed));
+    return lines.join("\n");
+}
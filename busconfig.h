@@ -0,0 +1,58 @@
+#ifndef BUSCONFIG_H
+#define BUSCONFIG_H
+
+#include <QMap>
+#include <QList>
+#include <QStringList>
+#include "deviceimage.h"
+#include "profile.h"
+
+///Configures the controllers daisy-chained on one link in a single pass.
+///All the images are prepared in the library first, then written back to back
+///through the differential writer, so that unchanged axes cost nothing and the
+///link is kept busy, and every address is read back to verify it.
+class BusConfigurator
+{
+    public:
+        struct DeviceReport
+        {
+            int address { 0 };
+            int axesWritten { 0 };
+            int axesSkipped { 0 };
+            bool verified { false };
+            ///parameters that read back different from what was written
+            QStringList mismatches;
+            double write_ms { 0.0 };
+            double verify_ms { 0.0 };
+        };
+        struct Report
+        {
+            QList<DeviceReport> devices;
+            double elapsed_ms { 0.0 };
+            int failed { 0 };
+            ///one line per address
+            QString text() const;
+        };
+
+        BusConfigurator(DifferentialWriter *writer);
+
+        ///Apply profile to every address from first to last
+        void setRange(int first, int last, Profile profile);
+        ///Apply profile to address, replacing what setRange() gave it
+        void setProfile(int address, Profile profile);
+        ///Read every address back after writing it, on by default
+        void setVerify(bool enabled)
+        {
+            verify = enabled;
+        }
+        ///Write every address, percent and finished as for ahp_gt_write_values.
+        ///The previously selected address is selected again at the end.
+        Report run(int *percent, int *finished, bool force = false);
+
+    private:
+        DifferentialWriter *writer;
+        QMap<int, Profile> profiles;
+        bool verify { true };
+};
+
+#endif // BUSCONFIG_H
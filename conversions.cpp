@@ -0,0 +1,54 @@
+#include "conversions.h"
+#include <cmath>
+#include <QStringList>
+
+void toDms(double d, double dms[3])
+{
+    dms[0] = floor(d);
+    d -= dms[0];
+    d *= 60.0;
+    dms[1] = floor(d);
+    d -= dms[1];
+    d *= 60.0;
+    dms[2] = d;
+}
+
+QString toHMS(double hms)
+{
+    double h, m, s;
+    hms = fabs(hms);
+    h = floor(hms);
+    hms -= h;
+    hms *= 60.0;
+    m = floor(hms);
+    hms -= m;
+    hms *= 60000.0;
+    s = floor(hms) / 1000.0;
+    return QString::number(h) + QString(":") + QString::number(m) + QString(":") + QString::number(s);
+}
+
+QString toDMS(double dms)
+{
+    double d, m, s;
+    dms = fabs(dms);
+    d = floor(dms);
+    dms -= d;
+    dms *= 60.0;
+    m = floor(dms);
+    dms -= m;
+    dms *= 60000.0;
+    s = floor(dms) / 1000.0;
+    return QString::number(d) + QString(":") + QString::number(m) + QString(":") + QString::number(s);
+}
+
+double fromHMSorDMS(QString dms)
+{
+    double d;
+    double m;
+    double s;
+    QStringList deg = dms.split(":");
+    d = deg.value(0).toDouble();
+    m = deg.value(1).toDouble() / 60.0 * (d < 0 ? -1 : 1);
+    s = deg.value(2).toDouble() / 3600.0 * (d < 0 ? -1 : 1);
+    return d + m + s;
+}
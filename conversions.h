@@ -0,0 +1,15 @@
+#ifndef CONVERSIONS_H
+#define CONVERSIONS_H
+
+#include <QString>
+
+///Split decimal degrees (or hours) into degrees, minutes and seconds, the sign stays on the degrees
+void toDms(double d, double dms[3]);
+///Format the absolute value of decimal hours as h:m:s
+QString toHMS(double hms);
+///Format the absolute value of decimal degrees as d:m:s
+QString toDMS(double dms);
+///Parse d:m:s or h:m:s into a decimal value, the sign of the first field applies to all
+double fromHMSorDMS(QString dms);
+
+#endif // CONVERSIONS_H
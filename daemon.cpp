@@ -0,0 +1,363 @@
+#include "daemon.h"
+#include <csignal>
+#include <cstdio>
+#include <cmath>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QStandardPaths>
+#include <QTimer>
+#include <QFile>
+#include <QScopedPointer>
+#include "trace.h"
+#include "busconfig.h"
+#include "fleet.h"
+#include "discovery.h"
+#include "profilefile.h"
+#include "profilelibrary.h"
+
+static std::atomic<int> quitRequested(0);
+static std::atomic<int> traceRequested(0);
+
+static void requestQuit(int)
+{
+    quitRequested = 1;
+}
+
+static void requestTrace(int)
+{
+    traceRequested = 1;
+}
+
+Daemon::Daemon(Options opt, QObject *parent) : QObject(parent)
+{
+    options = opt;
+    scheduler = new Scheduler(this);
+}
+
+Daemon::~Daemon()
+{
+    stop();
+}
+
+bool Daemon::start()
+{
+    ahp_set_app_name("GT Configurator");
+    ahp_gt_clear();
+    int failure = 1;
+    if(options.port.contains(':'))
+    {
+        QString address = options.port.split(":")[0];
+        int port = options.port.split(":")[1].toInt();
+        failure = ahp_gt_connect_udp(address.toStdString().c_str(), port);
+    }
+    else
+        failure = ahp_gt_connect(options.port.toUtf8());
+    if(failure)
+    {
+        fprintf(stderr, "cannot connect to %s\n", options.port.toUtf8().constData());
+        return false;
+    }
+    if(!ahp_gt_is_detected())
+    {
+        int percent = 0;
+        ahp_gt_detect_device(&percent);
+    }
+    if(!ahp_gt_is_detected())
+    {
+        fprintf(stderr, "no controller found on %s\n", options.port.toUtf8().constData());
+        ahp_gt_disconnect();
+        return false;
+    }
+    connected = true;
+    DeviceCache cache(QStandardPaths::standardLocations(QStandardPaths::AppDataLocation).at(0) + "/devices.cache");
+    QString device = DeviceCache::deviceKey(options.port);
+    int address = ahp_gt_get_current_device();
+    int version = ahp_gt_get_mc_version();
+    DeviceImage cached;
+    if(!options.readBack && cache.lookup(device, address, version, &cached))
+        cached.restore();
+    else
+    {
+        ahp_gt_read_values(0);
+        ahp_gt_read_values(1);
+        cache.store(device, address, version, DeviceImage::capture());
+    }
+    writer.recordRead();
+    //read before the profile is applied, Profile::apply() clears the high speed flag
+    writer.setBaudRate(DifferentialWriter::linkBaudRate());
+    Profile profile = Profile::load(options.profile);
+    if(!options.libraryProfile.isEmpty())
+    {
+        ProfileLibrary library(QStandardPaths::standardLocations(QStandardPaths::AppDataLocation).at(0) + "/profiles.library");
+        library.open();
+        int index = library.indexOf(options.libraryProfile);
+        if(options.libraryProfile == "auto")
+        {
+            QList<int> matches = library.match(device, version, address, mounttypes.indexOf(ahp_gt_get_mount_type()));
+            index = matches.isEmpty() ? -1 : matches.first();
+        }
+        if(index >= 0)
+        {
+            profile = library.entry(index).profile;
+            fprintf(stderr, "library profile %s\n", library.entry(index).name.toUtf8().constData());
+        }
+        else
+            fprintf(stderr, "no library profile %s, using %s\n", options.libraryProfile.toUtf8().constData(),
+                    options.profile.toUtf8().constData());
+    }
+    profile.apply();
+    if(options.write && (options.busFirst >= 0 || !options.busProfiles.isEmpty()))
+    {
+        BusConfigurator bus(&writer);
+        if(options.busFirst >= 0)
+            bus.setRange(options.busFirst, options.busLast, profile);
+        for(int address : options.busProfiles.keys())
+            bus.setProfile(address, Profile::load(options.busProfiles[address]));
+        BusConfigurator::Report report = bus.run(nullptr, nullptr);
+        for(BusConfigurator::DeviceReport written : report.devices)
+            cache.forget(device, written.address);
+        fprintf(stderr, "%s\n", report.text().toUtf8().constData());
+        profile.apply();
+    }
+    else if(options.write)
+    {
+        DifferentialWriter::Summary summary = writer.write(nullptr, nullptr);
+        cache.store(device, address, version, DeviceImage::capture());
+        fprintf(stderr, "profile written: %d axes written, %d skipped in %.0f ms\n",
+                summary.axesWritten, summary.axesSkipped, summary.elapsed_ms);
+    }
+    ahp_gt_set_location(profile.latitude, profile.longitude, 0);
+    telemetry.reset();
+    for(int a = 0; a < 2; a++)
+    {
+        telemetry.setEstimator(a, (EstimatorType)profile.axis[a].estimator, profile.axis[a].mean);
+        if(options.track[a])
+            ahp_gt_start_tracking(a);
+    }
+    TelemetryJob = scheduler->addPeriodic("Telemetry", options.telemetry_ms > 0 ? options.telemetry_ms : 1000, [ = ] ()
+    {
+        telemetry.sample();
+        TelemetrySnapshot snapshot = telemetry.snapshot();
+        for(int a = 0; a < 2; a++)
+        {
+            //with the server running the client owns the motion
+            if(options.track[a] && options.serverPort == 0 && snapshot.axis[a].status.Running == 0)
+                ahp_gt_start_tracking(a);
+        }
+        if(options.telemetry_ms > 0)
+        {
+            fprintf(stdout, "%lld,%.0f,%g,%g,%d,%.0f,%g,%g,%d\n", (long long)snapshot.sampled_ms,
+                    snapshot.axis[0].steps, snapshot.axis[0].speed, sqrt(snapshot.axis[0].speed_variance), snapshot.axis[0].status.Running,
+                    snapshot.axis[1].steps, snapshot.axis[1].speed, sqrt(snapshot.axis[1].speed_variance), snapshot.axis[1].status.Running);
+            fflush(stdout);
+        }
+    });
+    if(options.serverPort > 0)
+    {
+        serverStopped = 0;
+        int port = options.serverPort;
+        ServerJob = scheduler->runBlocking("Server", [ = ] ()
+        {
+            ahp_gt_set_aligned(1);
+            ahp_gt_start_synscan_server(port, &serverStopped);
+            serverStopped = 1;
+        });
+    }
+    return true;
+}
+
+void Daemon::stop()
+{
+    serverStopped = 1;
+    scheduler->stop();
+    if(connected)
+    {
+        ahp_gt_stop_motion(0, 0);
+        ahp_gt_stop_motion(1, 0);
+        ahp_gt_disconnect();
+        connected = false;
+    }
+}
+
+QString Daemon::startupReport(qint64 elapsed_ms)
+{
+    QString rss = "n/a";
+    QFile status("/proc/self/status");
+    if(status.open(QIODevice::ReadOnly))
+    {
+        for(QByteArray line : status.readAll().split('\n'))
+        {
+            if(line.startsWith("VmRSS:"))
+                rss = QString(line.mid(6)).simplified();
+        }
+        status.close();
+    }
+    return "startup " + QString::number(elapsed_ms) + " ms, rss " + rss;
+}
+
+int Daemon::exec(int argc, char *argv[], QElapsedTimer uptime)
+{
+    QCoreApplication app(argc, argv);
+    //same data directory as the configurator window, whatever the binary is called
+    QCoreApplication::setApplicationName("gt-configurator");
+    QCommandLineParser parser;
+    parser.setApplicationDescription("GT Configurator headless mode");
+    parser.addHelpOption();
+    QCommandLineOption headless("headless", "Run without the configurator window.");
+    QCommandLineOption port("port", "Serial port or host:port of the controller, auto for the first one answering, defaults to the last one used.", "port");
+    QCommandLineOption profile("profile", "INI or binary (" BINARY_PROFILE_SUFFIX ") profile to apply, defaults to the configurator settings.", "ini");
+    QCommandLineOption server("server-port", "SynScan server UDP port, 0 disables it.", "port", "11882");
+    QCommandLineOption track("track", "Axes to keep tracking: none, ra, dec or both.", "axes", "none");
+    QCommandLineOption interval("telemetry", "Telemetry interval in ms, 0 disables the output.", "ms", "1000");
+    QCommandLineOption write("write", "Write the profile to the controller after connecting.");
+    QCommandLineOption readBack("read-back", "Read the configuration from the controller even if the cache holds it.");
+    QCommandLineOption startup("startup-only", "Print startup time and resident memory, then quit.");
+    QCommandLineOption bus("bus", "With --write, write the profile to every bus address in the range.", "first-last");
+    QCommandLineOption busProfile("bus-profile", "With --write, write ini to a single bus address, can be repeated.", "address=ini");
+    QCommandLineOption fleetFile("fleet", "Run every mount of the INI file in its own session, telemetry prints the fleet totals.", "ini");
+    QCommandLineOption convert("convert", "Convert the profile to file, binary if it ends with " BINARY_PROFILE_SUFFIX ", then quit.", "file");
+    QCommandLineOption library("library", "Apply the named profile of the library, auto for the best match of the controller.", "name");
+    QCommandLineOption libraryImport("library-import", "Import the INI and binary profiles of dir into the library, then quit.", "dir");
+    parser.addOptions({ headless, port, profile, server, track, interval, write, readBack, startup, bus, busProfile, fleetFile, convert,
+                        library, libraryImport });
+    parser.process(app);
+
+    Options options;
+    options.profile = parser.value(profile);
+    if(options.profile.isEmpty())
+        options.profile = QStandardPaths::standardLocations(QStandardPaths::AppDataLocation).at(0) + "/settings.ini";
+    if(parser.isSet(convert))
+    {
+        QString to = parser.value(convert);
+        bool binarySource = options.profile.endsWith(BINARY_PROFILE_SUFFIX);
+        bool binaryTarget = to.endsWith(BINARY_PROFILE_SUFFIX);
+        bool ok = false;
+        if(binarySource == binaryTarget)
+            ok = QFile::copy(options.profile, to);
+        else if(binaryTarget)
+            ok = BinaryProfile::importIni(options.profile, to);
+        else
+            ok = BinaryProfile::exportIni(options.profile, to);
+        if(!ok)
+            fprintf(stderr, "cannot convert %s to %s\n", options.profile.toUtf8().constData(), to.toUtf8().constData());
+        return ok ? 0 : 1;
+    }
+    if(parser.isSet(libraryImport))
+    {
+        ProfileLibrary profiles(QStandardPaths::standardLocations(QStandardPaths::AppDataLocation).at(0) + "/profiles.library");
+        QStringList failed;
+        if(!profiles.open())
+        {
+            fprintf(stderr, "cannot read %s\n", profiles.fileName().toUtf8().constData());
+            return 1;
+        }
+        int imported = profiles.importDirectory(parser.value(libraryImport), &failed);
+        for(QString file : failed)
+            fprintf(stderr, "skipped %s\n", file.toUtf8().constData());
+        fprintf(stderr, "%d profiles imported, %d in the library\n", imported, profiles.count());
+        return profiles.save() ? 0 : 1;
+    }
+    options.libraryProfile = parser.value(library);
+    options.port = parser.value(port);
+    if(options.port.isEmpty())
+        options.port = Profile::load(options.profile).last_port;
+    if(options.port == "auto")
+    {
+        QList<PortDiscovery::Result> found = PortDiscovery::scan(PortDiscovery::candidates(QStringList() << "localhost:11880"));
+        options.port.clear();
+        if(!found.isEmpty() && found.first().detected)
+        {
+            options.port = found.first().port;
+            fprintf(stderr, "found %s mount, firmware %s on %s\n", found.first().mountName().toUtf8().constData(),
+                    found.first().firmware().toUtf8().constData(), options.port.toUtf8().constData());
+        }
+    }
+    options.serverPort = parser.value(server).toInt();
+    options.track[0] = (parser.value(track) == "ra" || parser.value(track) == "both");
+    options.track[1] = (parser.value(track) == "dec" || parser.value(track) == "both");
+    options.telemetry_ms = parser.value(interval).toInt();
+    options.write = parser.isSet(write);
+    options.readBack = parser.isSet(readBack);
+    options.startupOnly = parser.isSet(startup);
+    if(parser.isSet(bus))
+    {
+        QStringList range = parser.value(bus).split('-');
+        options.busFirst = range.first().toInt();
+        options.busLast = range.last().toInt();
+    }
+    for(QString value : parser.values(busProfile))
+    {
+        int separator = value.indexOf('=');
+        if(separator > 0)
+            options.busProfiles.insert(value.left(separator).toInt(), value.mid(separator + 1));
+    }
+    Fleet fleet(QCoreApplication::applicationFilePath());
+    QTimer fleetStats;
+    if(parser.isSet(fleetFile) && !options.startupOnly)
+    {
+        for(Fleet::Mount mount : Fleet::load(parser.value(fleetFile)))
+            fleet.add(mount);
+        if(fleet.count() == 0)
+        {
+            fprintf(stderr, "no mounts in %s\n", parser.value(fleetFile).toUtf8().constData());
+            return 1;
+        }
+        fleet.start();
+        connect(&fleetStats, &QTimer::timeout, &app, [ & ] ()
+        {
+            fprintf(stdout, "%s\n", fleet.stats().text().toUtf8().constData());
+            fflush(stdout);
+        });
+        if(options.telemetry_ms > 0)
+            fleetStats.start(options.telemetry_ms);
+    }
+    else if(options.port.isEmpty() && !options.startupOnly)
+    {
+        fprintf(stderr, "no port given and none used before\n");
+        return 1;
+    }
+
+    //the fleet runs every mount in a child process, only a single mount needs a session here
+    QScopedPointer<Daemon> daemon;
+    if(fleet.count() == 0)
+    {
+        daemon.reset(new Daemon(options));
+        if(!options.startupOnly && !daemon->start())
+            return 1;
+    }
+    if(options.startupOnly)
+    {
+        QTimer::singleShot(0, &app, [ = ] ()
+        {
+            fprintf(stdout, "%s\n", startupReport(uptime.elapsed()).toUtf8().constData());
+            QCoreApplication::quit();
+        });
+        return app.exec();
+    }
+    signal(SIGINT, requestQuit);
+    signal(SIGTERM, requestQuit);
+#ifdef SIGUSR1
+    //toggles tracing, the trace is written when it stops
+    signal(SIGUSR1, requestTrace);
+#endif
+    QTimer watch;
+    connect(&watch, &QTimer::timeout, &app, [ & ] ()
+    {
+        if(traceRequested.exchange(0))
+            fprintf(stderr, Trace::toggle(Trace::fileName()) ? "tracing started\n" : "trace written to %s\n",
+                    Trace::fileName().toUtf8().constData());
+        if(quitRequested)
+            QCoreApplication::quit();
+    });
+    watch.start(200);
+    int ret = app.exec();
+    if(fleet.count() > 0)
+    {
+        fleet.stop();
+        fprintf(stderr, "%s\n", fleet.report().toUtf8().constData());
+    }
+    if(daemon)
+        daemon->stop();
+    Trace::stop();
+    return ret;
+}
@@ -0,0 +1,69 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QMap>
+#include <QElapsedTimer>
+#include <atomic>
+#include "threads.h"
+#include "telemetry.h"
+#include "deviceimage.h"
+#include "profile.h"
+
+///Widget-free runner for unattended nodes: connects a port, applies a profile
+///and keeps the SynScan server, tracking and telemetry going on a QCoreApplication.
+class Daemon : public QObject
+{
+        Q_OBJECT
+    public:
+        struct Options
+        {
+            QString port;
+            QString profile;
+            ///SynScan server UDP port, 0 disables the server
+            int serverPort { 11882 };
+            ///track[axis]: keep the axis at sidereal rate
+            bool track[2] { false, false };
+            ///interval of the telemetry lines on stdout, 0 disables them
+            int telemetry_ms { 1000 };
+            ///push the profile to the controller after connecting
+            bool write { false };
+            ///bus addresses written with write set, -1 for the profile address only
+            int busFirst { -1 };
+            int busLast { -1 };
+            ///profiles of single bus addresses, overriding the common one
+            QMap<int, QString> busProfiles;
+            ///report startup time and memory, then quit
+            bool startupOnly { false };
+            ///library entry applied instead of profile, auto for the best match of the controller
+            QString libraryProfile;
+            ///read the configuration back even if the cache holds it
+            bool readBack { false };
+        };
+
+        Daemon(Options options, QObject *parent = nullptr);
+        ~Daemon();
+
+        ///Connect and start the jobs, false if the controller could not be reached
+        bool start();
+        void stop();
+
+        ///Parse the command line and run until SIGINT/SIGTERM, uptime started at process entry
+        static int exec(int argc, char *argv[], QElapsedTimer uptime);
+        ///One line with the time since process start and the resident memory
+        static QString startupReport(qint64 elapsed_ms);
+
+    private:
+        Options options;
+        Scheduler *scheduler;
+        TelemetrySampler telemetry;
+        DifferentialWriter writer;
+        int TelemetryJob { -1 };
+        int ServerJob { -1 };
+        int serverStopped { 1 };
+        bool connected { false };
+};
+
+#endif // DAEMON_H
@@ -0,0 +1,308 @@
+#include "deviceimage.h"
+#include <QBuffer>
+#include <QDataStream>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QSerialPortInfo>
+#include <QSettings>
+
+DeviceImage DeviceImage::capture()
+{
+    DeviceImage image;
+    image.mount_type = ahp_gt_get_mount_type();
+    image.mount_flags = ahp_gt_get_mount_flags();
+    for(int a = 0; a < 2; a++)
+    {
+        AxisImage &axis = image.axis[a];
+        axis.motor_steps = ahp_gt_get_motor_steps(a);
+        axis.motor_teeth = ahp_gt_get_motor_teeth(a);
+        axis.worm_teeth = ahp_gt_get_worm_teeth(a);
+        axis.crown_teeth = ahp_gt_get_crown_teeth(a);
+        axis.max_speed = ahp_gt_get_max_speed(a);
+        axis.acceleration = ahp_gt_get_acceleration_angle(a);
+        axis.direction_invert = ahp_gt_get_direction_invert(a);
+        axis.stepping_conf = ahp_gt_get_stepping_conf(a);
+        axis.stepping_mode = ahp_gt_get_stepping_mode(a);
+        axis.feature = ahp_gt_get_feature(a);
+        axis.features = ahp_gt_get_features(a);
+        axis.pwm_frequency = ahp_gt_get_pwm_frequency(a);
+    }
+    return image;
+}
+
+void DeviceImage::restore() const
+{
+    ahp_gt_set_mount_type((MountType)mount_type);
+    ahp_gt_set_mount_flags((GTFlags)mount_flags);
+    for(int a = 0; a < 2; a++)
+    {
+        const AxisImage &x = axis[a];
+        ahp_gt_set_motor_steps(a, x.motor_steps);
+        ahp_gt_set_motor_teeth(a, x.motor_teeth);
+        ahp_gt_set_worm_teeth(a, x.worm_teeth);
+        ahp_gt_set_crown_teeth(a, x.crown_teeth);
+        ahp_gt_set_max_speed(a, x.max_speed);
+        ahp_gt_set_acceleration_angle(a, x.acceleration);
+        ahp_gt_set_direction_invert(a, x.direction_invert);
+        ahp_gt_set_stepping_conf(a, (GTSteppingConfiguration)x.stepping_conf);
+        ahp_gt_set_stepping_mode(a, (GTSteppingMode)x.stepping_mode);
+        ahp_gt_set_feature(a, (GT1Feature)x.feature);
+        ahp_gt_set_features(a, (SkywatcherFeature)x.features);
+        ahp_gt_set_pwm_frequency(a, x.pwm_frequency);
+    }
+}
+
+QByteArray DeviceImage::toBytes() const
+{
+    QByteArray bytes;
+    QBuffer buffer(&bytes);
+    buffer.open(QIODevice::WriteOnly);
+    QDataStream out(&buffer);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << (qint32)mount_type << (qint32)mount_flags;
+    for(int a = 0; a < 2; a++)
+    {
+        const AxisImage &x = axis[a];
+        out << (qint32)x.motor_steps << (qint32)x.motor_teeth << (qint32)x.worm_teeth << (qint32)x.crown_teeth
+            << x.max_speed << x.acceleration << (qint32)x.direction_invert << (qint32)x.stepping_conf
+            << (qint32)x.stepping_mode << (qint32)x.feature << (qint32)x.features << (qint32)x.pwm_frequency;
+    }
+    return bytes;
+}
+
+bool DeviceImage::fromBytes(QByteArray bytes, DeviceImage *image)
+{
+    QDataStream in(bytes);
+    in.setVersion(QDataStream::Qt_5_0);
+    qint32 v[10];
+    in >> v[0] >> v[1];
+    image->mount_type = v[0];
+    image->mount_flags = v[1];
+    for(int a = 0; a < 2; a++)
+    {
+        AxisImage &x = image->axis[a];
+        in >> v[0] >> v[1] >> v[2] >> v[3] >> x.max_speed >> x.acceleration >> v[4] >> v[5] >> v[6] >> v[7] >> v[8] >> v[9];
+        x.motor_steps = v[0];
+        x.motor_teeth = v[1];
+        x.worm_teeth = v[2];
+        x.crown_teeth = v[3];
+        x.direction_invert = v[4];
+        x.stepping_conf = v[5];
+        x.stepping_mode = v[6];
+        x.feature = v[7];
+        x.features = v[8];
+        x.pwm_frequency = v[9];
+    }
+    return in.status() == QDataStream::Ok && in.atEnd();
+}
+
+QStringList DeviceImage::diff(const DeviceImage &other, int a) const
+{
+    QStringList changed;
+    const AxisImage &x = axis[a];
+    const AxisImage &y = other.axis[a];
+    //the mount-wide settings are stored on every axis
+    if(mount_type != other.mount_type)
+        changed.append("mount_type");
+    if(mount_flags != other.mount_flags)
+        changed.append("mount_flags");
+    if(x.motor_steps != y.motor_steps)
+        changed.append("motor_steps");
+    if(x.motor_teeth != y.motor_teeth)
+        changed.append("motor_teeth");
+    if(x.worm_teeth != y.worm_teeth)
+        changed.append("worm_teeth");
+    if(x.crown_teeth != y.crown_teeth)
+        changed.append("crown_teeth");
+    if(x.max_speed != y.max_speed)
+        changed.append("max_speed");
+    if(x.acceleration != y.acceleration)
+        changed.append("acceleration");
+    if(x.direction_invert != y.direction_invert)
+        changed.append("direction_invert");
+    if(x.stepping_conf != y.stepping_conf)
+        changed.append("stepping_conf");
+    if(x.stepping_mode != y.stepping_mode)
+        changed.append("stepping_mode");
+    if(x.feature != y.feature)
+        changed.append("feature");
+    if(x.features != y.features)
+        changed.append("features");
+    if(x.pwm_frequency != y.pwm_frequency)
+        changed.append("pwm_frequency");
+    return changed;
+}
+
+DifferentialWriter::DifferentialWriter(int baud)
+{
+    baudrate = baud;
+}
+
+void DifferentialWriter::setBaudRate(int baud)
+{
+    QMutexLocker locker(&mutex);
+    baudrate = baud;
+}
+
+int DifferentialWriter::linkBaudRate()
+{
+    return (ahp_gt_get_mount_flags() & bauds_115200) ? 115200 : 9600;
+}
+
+void DifferentialWriter::recordRead()
+{
+    DeviceImage image = DeviceImage::capture();
+    QMutexLocker locker(&mutex);
+    int address = ahp_gt_get_current_device();
+    shadow.insert(address, image);
+    stale.remove(address);
+}
+
+void DifferentialWriter::forget(int address)
+{
+    QMutexLocker locker(&mutex);
+    shadow.remove(address);
+    stale.remove(address);
+}
+
+void DifferentialWriter::invalidate(int axis)
+{
+    QMutexLocker locker(&mutex);
+    int address = ahp_gt_get_current_device();
+    stale[address] |= 1 << axis;
+}
+
+DifferentialWriter::Summary DifferentialWriter::write(int *percent, int *finished, bool force)
+{
+    Summary summary;
+    DeviceImage image = DeviceImage::capture();
+    int address = ahp_gt_get_current_device();
+    summary.address = address;
+    bool write[2] = { true, true };
+    {
+        QMutexLocker locker(&mutex);
+        summary.forced = force || !shadow.contains(address);
+        if(!summary.forced)
+        {
+            const DeviceImage &old = shadow[address];
+            int mask = stale.value(address, 0);
+            for(int a = 0; a < 2; a++)
+            {
+                QStringList changed = image.diff(old, a);
+                if(mask & (1 << a))
+                    changed.append("timing");
+                for(QString name : changed)
+                    summary.changed.append(QString("%1:%2").arg(a).arg(name));
+                write[a] = !changed.isEmpty();
+            }
+        }
+    }
+    QElapsedTimer timer;
+    timer.start();
+    for(int a = 0; a < 2; a++)
+    {
+        if(write[a])
+        {
+            QElapsedTimer axisTimer;
+            axisTimer.start();
+            ahp_gt_write_values(a, percent, finished);
+            double ms = axisTimer.nsecsElapsed() / 1000000.0;
+            QMutexLocker locker(&mutex);
+            axisWrites++;
+            axisWrite_ms += (ms - axisWrite_ms) / axisWrites;
+            summary.axesWritten++;
+        }
+        else
+            summary.axesSkipped++;
+    }
+    summary.elapsed_ms = timer.nsecsElapsed() / 1000000.0;
+    //the library raises these itself at the end of a write, do the same when nothing was sent
+    if(summary.axesWritten == 0)
+    {
+        if(percent)
+            *percent = 100;
+        if(finished)
+            *finished = 1;
+    }
+    QMutexLocker locker(&mutex);
+    summary.saved_ms = axisWrite_ms * summary.axesSkipped;
+    //one start and one stop bit per byte on the serial line
+    summary.bytesSaved = (quint64)(summary.saved_ms * baudrate / 10000.0);
+    shadow.insert(address, image);
+    stale.remove(address);
+    last = summary;
+    return summary;
+}
+
+DifferentialWriter::Summary DifferentialWriter::lastSummary()
+{
+    QMutexLocker locker(&mutex);
+    return last;
+}
+
+DeviceCache::DeviceCache(QString file)
+{
+    filename = file;
+}
+
+QString DeviceCache::deviceKey(QString port)
+{
+    //a USB adapter keeps its serial number when it moves to another port
+    for(QSerialPortInfo info : QSerialPortInfo::availablePorts())
+    {
+        if(info.portName() == port && !info.serialNumber().isEmpty())
+            return "usb-" + info.serialNumber();
+    }
+    return port;
+}
+
+///One group per controller, port names may hold slashes
+static QString cacheGroup(QString device, int address)
+{
+    return QString(device).replace('/', '_') + "@" + QString::number(address);
+}
+
+bool DeviceCache::lookup(QString device, int address, int version, DeviceImage *image)
+{
+    QMutexLocker locker(&mutex);
+    QSettings ini(filename, QSettings::IniFormat);
+    ini.beginGroup(cacheGroup(device, address));
+    QByteArray bytes = ini.value("image").toByteArray();
+    //another firmware may lay the parameters out differently, a damaged entry is as good as none
+    bool hit = ini.value("version", -1).toInt() == version && !bytes.isEmpty() &&
+               ini.value("checksum").toUInt() == qChecksum(bytes.constData(), bytes.length()) &&
+               DeviceImage::fromBytes(bytes, image);
+    ini.endGroup();
+    if(hit)
+        counters.hits++;
+    else
+        counters.misses++;
+    return hit;
+}
+
+void DeviceCache::store(QString device, int address, int version, const DeviceImage &image)
+{
+    QByteArray bytes = image.toBytes();
+    QMutexLocker locker(&mutex);
+    QSettings ini(filename, QSettings::IniFormat);
+    ini.beginGroup(cacheGroup(device, address));
+    ini.setValue("version", version);
+    ini.setValue("checksum", qChecksum(bytes.constData(), bytes.length()));
+    ini.setValue("image", bytes);
+    ini.setValue("cached", QDateTime::currentDateTimeUtc());
+    ini.endGroup();
+}
+
+void DeviceCache::forget(QString device, int address)
+{
+    QMutexLocker locker(&mutex);
+    QSettings ini(filename, QSettings::IniFormat);
+    ini.remove(cacheGroup(device, address));
+}
+
+DeviceCache::Stats DeviceCache::stats()
+{
+    QMutexLocker locker(&mutex);
+    return counters;
+}
@@ -0,0 +1,120 @@
+#ifndef DEVICEIMAGE_H
+#define DEVICEIMAGE_H
+
+#include <QByteArray>
+#include <QMap>
+#include <QMutex>
+#include <QStringList>
+#include <ahp_gt.h>
+
+///Configuration of one axis as the library sees it
+struct AxisImage
+{
+    int motor_steps;
+    int motor_teeth;
+    int worm_teeth;
+    int crown_teeth;
+    double max_speed;
+    double acceleration;
+    int direction_invert;
+    int stepping_conf;
+    int stepping_mode;
+    int feature;
+    int features;
+    int pwm_frequency;
+};
+
+///Configuration image of a controller, both axes plus the mount-wide settings
+struct DeviceImage
+{
+    int mount_type;
+    int mount_flags;
+    AxisImage axis[2];
+
+    ///Read the image of the current device from the library
+    static DeviceImage capture();
+    ///Set the image as the configuration of the current device, without talking to it
+    void restore() const;
+    QByteArray toBytes() const;
+    static bool fromBytes(QByteArray bytes, DeviceImage *image);
+    ///Names of the parameters of axis that differ from other, mount-wide ones included
+    QStringList diff(const DeviceImage &other, int axis) const;
+};
+
+///Keeps a shadow of what each bus address last held and only pushes the axes
+///whose configuration differs from it.
+class DifferentialWriter
+{
+    public:
+        struct Summary
+        {
+            int address { 0 };
+            bool forced { false };
+            int axesWritten { 0 };
+            int axesSkipped { 0 };
+            QStringList changed;
+            double elapsed_ms { 0.0 };
+            ///estimated from the measured duration of full axis writes
+            double saved_ms { 0.0 };
+            quint64 bytesSaved { 0 };
+        };
+
+        DifferentialWriter(int baudrate = 9600);
+
+        ///Rate of the link to the controller, bytesSaved is derived from it
+        void setBaudRate(int baud);
+        ///Rate the mount flags of the current device ask for
+        static int linkBaudRate();
+
+        ///Record the image of the current device after reading it from the controller
+        void recordRead();
+        ///Forget the shadow of an address, so that the next write is a full one
+        void forget(int address);
+        ///Mark an axis of the current device as changed by something the image does not cover
+        void invalidate(int axis);
+        ///Write the axes of the current device that changed, all of them if force is set
+        Summary write(int *percent, int *finished, bool force = false);
+        Summary lastSummary();
+
+    private:
+        QMutex mutex;
+        QMap<int, DeviceImage> shadow;
+        QMap<int, int> stale;
+        double axisWrite_ms { 0.0 };
+        int axisWrites { 0 };
+        int baudrate;
+        Summary last;
+};
+
+///Last image read from each controller, keyed by device and bus address.
+///A reconnect to a controller that still runs the same firmware takes the
+///image from here instead of reading every parameter back.  A controller
+///reconfigured by another host with the same firmware is not noticed, a
+///forced read refreshes the entry.
+class DeviceCache
+{
+    public:
+        struct Stats
+        {
+            quint64 hits { 0 };
+            quint64 misses { 0 };
+        };
+
+        DeviceCache(QString filename);
+
+        ///Key of the controller on port, its USB serial number when it has one, the port otherwise
+        static QString deviceKey(QString port);
+
+        ///Fill image with what address on device held under firmware version, false if unknown or damaged
+        bool lookup(QString device, int address, int version, DeviceImage *image);
+        void store(QString device, int address, int version, const DeviceImage &image);
+        void forget(QString device, int address);
+        Stats stats();
+
+    private:
+        QString filename;
+        QMutex mutex;
+        Stats counters;
+};
+
+#endif // DEVICEIMAGE_H
@@ -0,0 +1,257 @@
+#include "discovery.h"
+#include "threads.h"
+#include "trace.h"
+#include <algorithm>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QSerialPort>
+#include <QSerialPortInfo>
+#include <QUdpSocket>
+#include <QVector>
+#include <ahp_gt.h>
+
+///Firmware version query of the first axis, answered =XXYYZZ or !<error>
+static const char versionQuery[] = ":e1\r";
+
+static bool parseReply(QByteArray reply, PortDiscovery::Result *r)
+{
+    int start = reply.indexOf('=');
+    if(reply.contains('!'))
+    {
+        r->responded = true;
+        r->error = "error reply " + QString(reply.trimmed());
+        return true;
+    }
+    if(start < 0 || reply.length() < start + 7)
+        return false;
+    r->responded = true;
+    r->detected = true;
+    QByteArray hex = reply.mid(start + 1, 6);
+    quint32 version = 0;
+    for(int b = 0; b < 3; b++)
+    {
+        bool ok = false;
+        version |= hex.mid(b * 2, 2).toUInt(&ok, 16) << (8 * b);
+        r->detected &= ok;
+    }
+    r->version = version;
+    if(!r->detected)
+        r->error = "invalid reply " + QString(reply.trimmed());
+    return true;
+}
+
+///Collect bytes until the carriage return or timeout_ms
+static QByteArray readReply(QIODevice *io, int timeout_ms)
+{
+    QByteArray reply;
+    QElapsedTimer timer;
+    timer.start();
+    while(!reply.contains('\r') && timer.elapsed() < timeout_ms)
+    {
+        //-1 would wait forever
+        if(io->waitForReadyRead(qMax((qint64)1, timeout_ms - timer.elapsed())))
+            reply += io->readAll();
+    }
+    return reply;
+}
+
+///Probes running at once, the others wait for a free worker
+static const int maxWorkers = 16;
+
+PortDiscovery::PortDiscovery(QObject *parent) : QObject(parent)
+{
+    pool.setMaxThreadCount(maxWorkers);
+}
+
+PortDiscovery::~PortDiscovery()
+{
+    pool.waitForDone();
+}
+
+QStringList PortDiscovery::candidates(QStringList endpoints)
+{
+    QStringList ports;
+    for(QSerialPortInfo info : QSerialPortInfo::availablePorts())
+        ports.append(info.portName());
+    for(QString endpoint : endpoints)
+    {
+        if(!endpoint.isEmpty() && !ports.contains(endpoint))
+            ports.append(endpoint);
+    }
+    return ports;
+}
+
+PortDiscovery::Result PortDiscovery::probe(QString port, int timeout_ms)
+{
+    TRACE_SCOPE("port probe");
+    Result r;
+    r.port = port;
+    QElapsedTimer timer;
+    timer.start();
+    if(port.contains(':'))
+    {
+        QUdpSocket socket;
+        socket.connectToHost(port.split(":")[0], port.split(":")[1].toUShort());
+        if(!socket.waitForConnected(timeout_ms))
+        {
+            r.error = socket.errorString();
+            return r;
+        }
+        timer.restart();
+        socket.write(versionQuery);
+        QByteArray reply = readReply(&socket, timeout_ms);
+        if(parseReply(reply, &r))
+            r.latency_ms = timer.nsecsElapsed() / 1000000.0;
+        else
+            r.error = "no reply";
+        return r;
+    }
+    QSerialPort serial;
+    serial.setPortName(port);
+    if(!serial.open(QIODevice::ReadWrite))
+    {
+        r.error = serial.errorString();
+        return r;
+    }
+    //controllers with the high speed flag set only answer at 115200
+    for(int baud : { 9600, 115200 })
+    {
+        serial.setBaudRate(baud);
+        serial.clear();
+        timer.restart();
+        serial.write(versionQuery);
+        serial.waitForBytesWritten(timeout_ms);
+        QByteArray reply = readReply(&serial, timeout_ms);
+        if(parseReply(reply, &r))
+        {
+            r.baud = baud;
+            r.latency_ms = timer.nsecsElapsed() / 1000000.0;
+            break;
+        }
+    }
+    serial.close();
+    if(!r.responded)
+        r.error = "no reply";
+    return r;
+}
+
+void PortDiscovery::rank(QList<Result> *results)
+{
+    std::stable_sort(results->begin(), results->end(), [] (const Result & a, const Result & b)
+    {
+        if(a.detected != b.detected)
+            return a.detected;
+        if(a.responded != b.responded)
+            return a.responded;
+        return a.latency_ms < b.latency_ms;
+    });
+}
+
+QList<PortDiscovery::Result> PortDiscovery::scan(QStringList ports, int timeout_ms)
+{
+    QThreadPool workers;
+    workers.setMaxThreadCount(qBound(1, ports.count(), maxWorkers));
+    QVector<Result> probes(ports.count());
+    for(int i = 0; i < ports.count(); i++)
+    {
+        Result *r = &probes[i];
+        QString port = ports[i];
+        workers.start(new JobRunnable([ = ] ()
+        {
+            *r = probe(port, timeout_ms);
+        }));
+    }
+    workers.waitForDone();
+    QList<Result> results = probes.toList();
+    rank(&results);
+    return results;
+}
+
+void PortDiscovery::start(QStringList ports, int timeout_ms)
+{
+    if(isRunning() || ports.isEmpty())
+        return;
+    {
+        QMutexLocker locker(&mutex);
+        collected.clear();
+    }
+    //one worker per port up to maxWorkers, the slowest probe bounds the whole scan
+    remaining = ports.count();
+    int scan = ++generation;
+    for(QString port : ports)
+    {
+        pool.start(new JobRunnable([ = ] ()
+        {
+            Result r = probe(port, timeout_ms);
+            {
+                QMutexLocker locker(&mutex);
+                collected.append(r);
+            }
+            QMetaObject::invokeMethod(this, [ = ] ()
+            {
+                //a cancelled scan reports nothing
+                if(scan != generation)
+                    return;
+                if(r.detected)
+                    emit found(r.port);
+                if(--remaining == 0)
+                    emit finished();
+            }, Qt::QueuedConnection);
+        }));
+    }
+}
+
+void PortDiscovery::cancel()
+{
+    if(!isRunning())
+        return;
+    generation++;
+    //probes not started yet are dropped, the running ones close their ports within their timeout
+    pool.clear();
+    pool.waitForDone();
+    remaining = 0;
+}
+
+QList<PortDiscovery::Result> PortDiscovery::results()
+{
+    QMutexLocker locker(&mutex);
+    QList<Result> ranked = collected;
+    rank(&ranked);
+    return ranked;
+}
+
+QString PortDiscovery::Result::firmware() const
+{
+    return QString::number(version & 0xff, 16) + "." + QString::number((version >> 8) & 0xff, 16).rightJustified(2, '0');
+}
+
+QString PortDiscovery::Result::mountName() const
+{
+    switch(mountCode())
+    {
+        case isEQ6:
+            return "EQ6";
+        case isHEQ5:
+            return "HEQ5";
+        case isEQ5:
+            return "EQ5";
+        case isEQ3:
+            return "EQ3";
+        case isEQ8:
+            return "EQ8";
+        case isAZEQ6:
+            return "AZEQ6";
+        case isAZEQ5:
+            return "AZEQ5";
+        case isGT:
+            return "GT";
+        case isMF:
+            return "MF";
+        case is114GT:
+            return "114GT";
+        case isDOB:
+            return "DOB";
+        default:
+            return "custom";
+    }
+}
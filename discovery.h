@@ -0,0 +1,78 @@
+#ifndef DISCOVERY_H
+#define DISCOVERY_H
+
+#include <QObject>
+#include <QList>
+#include <QMutex>
+#include <QStringList>
+#include <QThreadPool>
+#include <atomic>
+
+///Finds the GT controllers on the serial ports and UDP endpoints.
+///Every candidate gets its own worker that sends the firmware version query
+///with a short timeout, without going through libahp_gt and its global link,
+///so a dead port costs one timeout and never delays the others.
+class PortDiscovery : public QObject
+{
+        Q_OBJECT
+    public:
+        struct Result
+        {
+            ///serial port name or host:port
+            QString port;
+            ///something answered the query
+            bool responded { false };
+            ///the answer was a valid version reply
+            bool detected { false };
+            int baud { 0 };
+            double latency_ms { 0.0 };
+            ///version reply as the controller sends it, 24 bits little endian
+            quint32 version { 0 };
+            QString error;
+            ///major.minor firmware version
+            QString firmware() const;
+            int mountCode() const
+            {
+                return (version >> 16) & 0xff;
+            }
+            QString mountName() const;
+        };
+
+        PortDiscovery(QObject *parent = nullptr);
+        ~PortDiscovery();
+
+        ///Serial ports of the system followed by endpoints, without duplicates
+        static QStringList candidates(QStringList endpoints = QStringList());
+        ///Query one port, blocking for at most about twice timeout_ms
+        static Result probe(QString port, int timeout_ms);
+        ///Query all the ports at once and rank them, blocking
+        static QList<Result> scan(QStringList ports, int timeout_ms = 200);
+        ///Detected controllers first, fastest first, then what answered, then the rest
+        static void rank(QList<Result> *results);
+
+        ///Query all the ports at once in the background
+        void start(QStringList ports, int timeout_ms = 200);
+        bool isRunning() const
+        {
+            return remaining > 0;
+        }
+        ///Drop the probes not started yet and wait for the running ones, no signal is emitted for the scan
+        void cancel();
+        ///Ranked results of the last scan
+        QList<Result> results();
+
+    signals:
+        ///A controller answered on port
+        void found(QString port);
+        void finished();
+
+    private:
+        QThreadPool pool;
+        QMutex mutex;
+        QList<Result> collected;
+        std::atomic<int> remaining { 0 };
+        ///scan the queued reports belong to
+        int generation { 0 };
+};
+
+#endif // DISCOVERY_H
@@ -0,0 +1,267 @@
+#include "estimator.h"
+#include <cmath>
+#include <cstring>
+
+VelocityEstimator::VelocityEstimator(EstimatorType t, int n)
+{
+    type = t;
+    kQ = 1e-9;
+    kR = 1e-8;
+    window = 1;
+    reset();
+    setWindow(n);
+}
+
+void VelocityEstimator::setType(EstimatorType t)
+{
+    //all the filters are kept up to date, the switch takes effect on the next sample
+    type = t;
+}
+
+void VelocityEstimator::setWindow(int n)
+{
+    window = (int)fmax(1, fmin(ESTIMATOR_CAPACITY - 1, n));
+    while(count > window + 1)
+        pop();
+}
+
+void VelocityEstimator::setKalmanNoise(double process, double measurement)
+{
+    kQ = fmax(0.0, process);
+    kR = fmax(1e-15, measurement);
+}
+
+void VelocityEstimator::reset()
+{
+    memset(&current, 0, sizeof(current));
+    head = 0;
+    count = 0;
+    sinceResum = 0;
+    t0 = x0 = 0.0;
+    lastT = lastX = 0.0;
+    primed = false;
+    sumT = sumX = sumTT = sumTX = sumXX = 0.0;
+    rates = 0;
+    sumR = sumRR = 0.0;
+    emaRate = emaVar = 0.0;
+    kX = kV = kT = 0.0;
+    memset(kP, 0, sizeof(kP));
+}
+
+void VelocityEstimator::push(double t, double x, double rate)
+{
+    int tail = (head + count) % ESTIMATOR_CAPACITY;
+    ring[tail].t = t;
+    ring[tail].x = x;
+    ring[tail].rate = rate;
+    count++;
+    double rt = t - t0;
+    double rx = x - x0;
+    sumT += rt;
+    sumX += rx;
+    sumTT += rt * rt;
+    sumTX += rt * rx;
+    sumXX += rx * rx;
+    if(count > 1)
+    {
+        rates++;
+        sumR += rate;
+        sumRR += rate * rate;
+    }
+}
+
+void VelocityEstimator::pop()
+{
+    double rt = ring[head].t - t0;
+    double rx = ring[head].x - x0;
+    sumT -= rt;
+    sumX -= rx;
+    sumTT -= rt * rt;
+    sumTX -= rt * rx;
+    sumXX -= rx * rx;
+    head = (head + 1) % ESTIMATOR_CAPACITY;
+    count--;
+    if(count > 0)
+    {
+        //the interval ending at the new oldest sample has lost its start
+        double rate = ring[head].rate;
+        rates--;
+        sumR -= rate;
+        sumRR -= rate * rate;
+    }
+}
+
+void VelocityEstimator::resum()
+{
+    //rebase on the oldest sample and drop the rounding error accumulated by
+    //the incremental updates, once every ESTIMATOR_CAPACITY samples
+    t0 = ring[head].t;
+    x0 = ring[head].x;
+    sumT = sumX = sumTT = sumTX = sumXX = 0.0;
+    sumR = sumRR = 0.0;
+    for(int s = 0; s < count; s++)
+    {
+        const Sample &sample = ring[(head + s) % ESTIMATOR_CAPACITY];
+        double rt = sample.t - t0;
+        double rx = sample.x - x0;
+        sumT += rt;
+        sumX += rx;
+        sumTT += rt * rt;
+        sumTX += rt * rx;
+        sumXX += rx * rx;
+        if(s > 0)
+        {
+            sumR += sample.rate;
+            sumRR += sample.rate * sample.rate;
+        }
+    }
+    rates = count > 0 ? count - 1 : 0;
+    sinceResum = 0;
+}
+
+VelocityEstimate VelocityEstimator::update(double t, double x)
+{
+    if(!primed)
+    {
+        primed = true;
+        lastT = t;
+        lastX = x;
+        t0 = t;
+        x0 = x;
+        push(t, x, 0.0);
+        kX = x;
+        kV = 0.0;
+        kT = t;
+        kP[0][0] = kR;
+        kP[0][1] = kP[1][0] = 0.0;
+        kP[1][1] = 1e6;
+        current.samples = 1;
+        return current;
+    }
+    double dt = t - lastT;
+    if(dt <= 0.0)
+        return current;
+    double rate = (x - lastX) / dt;
+    if(count > window)
+        pop();
+    push(t, x, rate);
+    if(++sinceResum >= ESTIMATOR_CAPACITY)
+        resum();
+    lastT = t;
+    lastX = x;
+    switch(type)
+    {
+        case EstimatorMovingAverage:
+            current = movingAverage();
+            break;
+        case EstimatorEMA:
+            current = ema(rate);
+            break;
+        case EstimatorLeastSquares:
+            current = leastSquares();
+            break;
+        case EstimatorKalman:
+            current = kalman(t, x);
+            break;
+        default:
+            break;
+    }
+    //keep the recursive filters warm so switching type does not restart them
+    if(type != EstimatorEMA)
+        ema(rate);
+    if(type != EstimatorKalman)
+        kalman(t, x);
+    return current;
+}
+
+VelocityEstimate VelocityEstimator::movingAverage()
+{
+    VelocityEstimate e;
+    e.samples = rates;
+    const Sample &oldest = ring[head];
+    const Sample &newest = ring[(head + count - 1) % ESTIMATOR_CAPACITY];
+    double span = newest.t - oldest.t;
+    e.rate = span > 0.0 ? (newest.x - oldest.x) / span : 0.0;
+    e.variance = 0.0;
+    if(rates > 1)
+    {
+        double mean = sumR / rates;
+        double s2 = fmax(0.0, (sumRR - rates * mean * mean) / (rates - 1));
+        e.variance = s2 / rates;
+    }
+    return e;
+}
+
+VelocityEstimate VelocityEstimator::ema(double rate)
+{
+    VelocityEstimate e;
+    double alpha = 2.0 / (window + 1.0);
+    if(rates <= 1)
+    {
+        emaRate = rate;
+        emaVar = 0.0;
+    }
+    else
+    {
+        double delta = rate - emaRate;
+        emaRate += alpha * delta;
+        emaVar = (1.0 - alpha) * (emaVar + alpha * delta * delta);
+    }
+    e.rate = emaRate;
+    //variance of an EMA fed with independent samples of variance emaVar
+    e.variance = emaVar * alpha / (2.0 - alpha);
+    e.samples = rates;
+    return e;
+}
+
+VelocityEstimate VelocityEstimator::leastSquares()
+{
+    VelocityEstimate e;
+    e.samples = count;
+    e.rate = 0.0;
+    e.variance = 0.0;
+    if(count < 2)
+        return e;
+    double n = count;
+    double stt = sumTT - sumT * sumT / n;
+    double stx = sumTX - sumT * sumX / n;
+    double sxx = sumXX - sumX * sumX / n;
+    if(stt <= 0.0)
+        return e;
+    e.rate = stx / stt;
+    if(count > 2)
+    {
+        double sse = fmax(0.0, sxx - e.rate * stx);
+        e.variance = sse / (n - 2.0) / stt;
+    }
+    return e;
+}
+
+VelocityEstimate VelocityEstimator::kalman(double t, double x)
+{
+    VelocityEstimate e;
+    double dt = t - kT;
+    kT = t;
+    //predict, constant velocity with white acceleration noise, a longer window means a stiffer model
+    double q = kQ / window;
+    kX += kV * dt;
+    double p00 = kP[0][0] + dt * (kP[1][0] + kP[0][1]) + dt * dt * kP[1][1] + q * dt * dt * dt / 3.0;
+    double p01 = kP[0][1] + dt * kP[1][1] + q * dt * dt / 2.0;
+    double p10 = kP[1][0] + dt * kP[1][1] + q * dt * dt / 2.0;
+    double p11 = kP[1][1] + q * dt;
+    //update with the measured position
+    double s = p00 + kR;
+    double k0 = p00 / s;
+    double k1 = p10 / s;
+    double y = x - kX;
+    kX += k0 * y;
+    kV += k1 * y;
+    kP[0][0] = (1.0 - k0) * p00;
+    kP[0][1] = (1.0 - k0) * p01;
+    kP[1][0] = p10 - k1 * p00;
+    kP[1][1] = p11 - k1 * p01;
+    e.rate = kV;
+    e.variance = fmax(0.0, kP[1][1]);
+    e.samples = count;
+    return e;
+}
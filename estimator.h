@@ -0,0 +1,98 @@
+#ifndef ESTIMATOR_H
+#define ESTIMATOR_H
+
+#define ESTIMATOR_CAPACITY 1024
+
+typedef enum
+{
+    ///Mean rate over the last N intervals, weighted by interval length
+    EstimatorMovingAverage = 0,
+    ///Exponential moving average of the interval rates
+    EstimatorEMA,
+    ///Least-squares slope of the last N timestamped samples
+    EstimatorLeastSquares,
+    ///Constant-velocity Kalman filter
+    EstimatorKalman,
+} EstimatorType;
+
+struct VelocityEstimate
+{
+    ///Rate in position units per second
+    double rate;
+    ///Variance of the rate, squared rate units
+    double variance;
+    ///Samples that contributed to the estimate
+    int samples;
+};
+
+///Per-axis velocity estimator, every update is O(1) on a ring buffer of
+///timestamped positions so the cost does not depend on the window length
+///and irregular polling intervals are accounted for.
+class VelocityEstimator
+{
+    public:
+        VelocityEstimator(EstimatorType type = EstimatorMovingAverage, int window = 1);
+
+        void setType(EstimatorType type);
+        EstimatorType getType() const
+        {
+            return type;
+        }
+        ///Samples retained by the moving average and least squares filters,
+        ///sets the smoothing constant of the EMA and the process noise of the Kalman filter
+        void setWindow(int n);
+        int getWindow() const
+        {
+            return window;
+        }
+        ///Kalman filter tuning: acceleration noise density and measurement variance
+        void setKalmanNoise(double process, double measurement);
+        void reset();
+        ///Feed a new position sampled at timestamp (seconds)
+        VelocityEstimate update(double timestamp, double position);
+        VelocityEstimate estimate() const
+        {
+            return current;
+        }
+
+    private:
+        struct Sample
+        {
+            double t;
+            double x;
+            double rate;
+        };
+        void push(double t, double x, double rate);
+        void pop();
+        void resum();
+        VelocityEstimate movingAverage();
+        VelocityEstimate ema(double rate);
+        VelocityEstimate leastSquares();
+        VelocityEstimate kalman(double t, double x);
+
+        EstimatorType type;
+        int window;
+        VelocityEstimate current;
+
+        Sample ring[ESTIMATOR_CAPACITY];
+        int head;
+        int count;
+        int sinceResum;
+        double t0, x0;
+        double lastT, lastX;
+        bool primed;
+
+        //running sums over the samples in the ring, relative to t0/x0
+        double sumT, sumX, sumTT, sumTX, sumXX;
+        //running sums over the interval rates in the ring
+        int rates;
+        double sumR, sumRR;
+
+        double emaRate, emaVar;
+
+        double kX, kV, kT;
+        double kP[2][2];
+        double kQ, kR;
+};
+
+#endif // ESTIMATOR_H
@@ -0,0 +1,563 @@
+#include "firmware.h"
+#include "trace.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QRegExp>
+#include <QResource>
+#include <QSaveFile>
+#include <QSettings>
+#include <QTimer>
+#include <QUrlQuery>
+#include <cstdio>
+#include <fcntl.h>
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <io.h>
+#else
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+#ifdef Q_OS_LINUX
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+#endif
+
+static const QString CATALOG_KEY = "catalog";
+
+///Product name as listed by the catalog, "firmware/gt1-firmware.bin" is gt1
+static QString productName(QString entry)
+{
+    return entry.replace("firmware/", "").replace("-firmware.bin", "");
+}
+
+static QString imageKey(QString product)
+{
+    return "image-" + product;
+}
+
+///Base64 "data" field of a JSON document
+static QByteArray decodeData(QByteArray json)
+{
+    QJsonObject obj = QJsonDocument::fromJson(json).object();
+    QString base64 = obj["data"].toString();
+    if(base64.isNull() || base64.isEmpty())
+        return QByteArray();
+    return QByteArray::fromBase64(base64.toUtf8());
+}
+
+FirmwareCatalog::FirmwareCatalog(QString cacheDir, QObject *parent) : QObject(parent)
+{
+    dir = cacheDir;
+    QDir().mkpath(dir);
+    manager = new QNetworkAccessManager(this);
+    base = "https://www.iliaplatone.com/firmware.php";
+    QString url = QString::fromLocal8Bit(qgetenv("GT_FIRMWARE_URL"));
+    if(!url.isEmpty())
+        base = url;
+    QSettings index(dir + "/index.ini", QSettings::IniFormat);
+    for(QString key : index.childGroups())
+    {
+        //validators without a body would turn every 304 into an empty image
+        if(!QFile::exists(path(key)))
+            continue;
+        Entry e;
+        e.etag = index.value(key + "/etag").toString();
+        e.lastModified = index.value(key + "/last_modified").toString();
+        entries.insert(key, e);
+    }
+}
+
+void FirmwareCatalog::setBaseUrl(QString url)
+{
+    base = url;
+}
+
+void FirmwareCatalog::setTimeouts(int list_ms, int image_ms)
+{
+    list_timeout = list_ms;
+    image_timeout = image_ms;
+}
+
+QString FirmwareCatalog::path(QString key) const
+{
+    key.replace(QRegExp("[^A-Za-z0-9._-]"), "_");
+    return dir + "/" + key + ".bin";
+}
+
+FirmwareCatalog::Entry &FirmwareCatalog::entry(QString key)
+{
+    Entry &e = entries[key];
+    if(!e.loaded)
+    {
+        QFile f(path(key));
+        if(f.open(QIODevice::ReadOnly))
+        {
+            e.data = f.readAll();
+            f.close();
+        }
+        e.loaded = true;
+    }
+    return e;
+}
+
+void FirmwareCatalog::store(QString key, Entry e)
+{
+    QSaveFile f(path(key));
+    if(f.open(QIODevice::WriteOnly) && f.write(e.data) == e.data.length() && f.commit())
+    {
+        QSettings index(dir + "/index.ini", QSettings::IniFormat);
+        index.setValue(key + "/etag", e.etag);
+        index.setValue(key + "/last_modified", e.lastModified);
+    }
+    else
+    {
+        //kept in memory only, the next run downloads it again
+        e.etag.clear();
+        e.lastModified.clear();
+    }
+    e.loaded = true;
+    QMutexLocker locker(&mutex);
+    entries.insert(key, e);
+}
+
+void FirmwareCatalog::get(QString key, QUrl url, int timeout_ms, std::function<void(QByteArray, QString)> done)
+{
+    QNetworkRequest request(url);
+    request.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+    {
+        QMutexLocker locker(&mutex);
+        Entry &e = entry(key);
+        if(!e.data.isEmpty())
+        {
+            if(!e.etag.isEmpty())
+                request.setRawHeader("If-None-Match", e.etag.toUtf8());
+            if(!e.lastModified.isEmpty())
+                request.setRawHeader("If-Modified-Since", e.lastModified.toUtf8());
+        }
+    }
+    counters.requests++;
+    QNetworkReply *reply = manager->get(request);
+    QTimer *timer = new QTimer(reply);
+    timer->setSingleShot(true);
+    connect(timer, &QTimer::timeout, reply, &QNetworkReply::abort);
+    timer->start(timeout_ms);
+    connect(reply, &QNetworkReply::finished, this, [ = ] ()
+    {
+        TRACE_SCOPE("firmware download");
+        reply->deleteLater();
+        if(reply->error() != QNetworkReply::NoError)
+        {
+            counters.failures++;
+            done(QByteArray(), reply->errorString());
+            return;
+        }
+        if(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 304)
+        {
+            counters.notModified++;
+            QMutexLocker locker(&mutex);
+            QByteArray data = entry(key).data;
+            locker.unlock();
+            done(data, QString());
+            return;
+        }
+        QByteArray body = reply->readAll();
+        Entry e;
+        e.data = decodeData(body);
+        if(e.data.isEmpty())
+        {
+            counters.failures++;
+            done(QByteArray(), "no data in the reply");
+            return;
+        }
+        e.etag = QString::fromUtf8(reply->rawHeader("ETag"));
+        e.lastModified = QString::fromUtf8(reply->rawHeader("Last-Modified"));
+        counters.downloads++;
+        counters.bytesDownloaded += body.length();
+        store(key, e);
+        done(e.data, QString());
+    });
+}
+
+QStringList FirmwareCatalog::products()
+{
+    QMutexLocker locker(&mutex);
+    QByteArray list = entry(CATALOG_KEY).data;
+    locker.unlock();
+    QStringList names;
+    for(QString name : QJsonDocument::fromJson(list).toVariant().toStringList())
+        names.append(productName(name));
+    return names;
+}
+
+QByteArray FirmwareCatalog::image(QString product)
+{
+    QMutexLocker locker(&mutex);
+    return entry(imageKey(product)).data;
+}
+
+bool FirmwareCatalog::contains(QString product)
+{
+    return !image(product).isEmpty();
+}
+
+QString FirmwareCatalog::revision(QString product)
+{
+    QMutexLocker locker(&mutex);
+    Entry &e = entry(imageKey(product));
+    return e.lastModified.isEmpty() ? e.etag : e.lastModified;
+}
+
+void FirmwareCatalog::refresh()
+{
+    QUrl url(base);
+    QUrlQuery query;
+    query.addQueryItem("product", "gt*");
+    url.setQuery(query);
+    get(CATALOG_KEY, url, list_timeout, [ = ] (QByteArray data, QString error)
+    {
+        if(data.isEmpty())
+        {
+            emit failed(QString(), error);
+            return;
+        }
+        QStringList names = products();
+        emit listChanged(names);
+        if(prefetch)
+        {
+            for(QString product : names)
+                fetch(product);
+        }
+    });
+}
+
+void FirmwareCatalog::fetch(QString product)
+{
+    if(inflight.contains(product))
+        return;
+    inflight.insert(product, true);
+    QUrl url(base);
+    QUrlQuery query;
+    query.addQueryItem("download", "yes");
+    query.addQueryItem("product", product);
+    url.setQuery(query);
+    get(imageKey(product), url, image_timeout, [ = ] (QByteArray data, QString error)
+    {
+        inflight.remove(product);
+        if(data.isEmpty())
+            emit failed(product, error);
+        else
+            emit imageReady(product);
+    });
+}
+
+FirmwareCatalog::Stats FirmwareCatalog::stats()
+{
+    return counters;
+}
+
+FirmwareStore::FirmwareStore(QString directory, qint64 max_bytes, int max_images)
+{
+    dir = directory;
+    maxBytes = max_bytes;
+    maxImages = max_images;
+    QDir().mkpath(dir);
+    QSettings settings(dir + "/index.ini", QSettings::IniFormat);
+    for(QString hash : settings.childGroups())
+    {
+        Record r;
+        r.hash = hash;
+        r.product = settings.value(hash + "/product").toString();
+        r.version = settings.value(hash + "/version").toString();
+        r.size = settings.value(hash + "/size").toLongLong();
+        r.lastUsed = settings.value(hash + "/last_used").toDateTime();
+        if(QFileInfo(path(hash)).size() == r.size)
+            index.insert(hash, r);
+        else
+            settings.remove(hash);
+    }
+}
+
+FirmwareStore::~FirmwareStore()
+{
+}
+
+QString FirmwareStore::hash(QByteArray image)
+{
+    return QCryptographicHash::hash(image, QCryptographicHash::Sha256).toHex();
+}
+
+QString FirmwareStore::path(QString hash) const
+{
+    return dir + "/" + hash + ".bin";
+}
+
+void FirmwareStore::writeRecord(Record r)
+{
+    QSettings settings(dir + "/index.ini", QSettings::IniFormat);
+    settings.setValue(r.hash + "/product", r.product);
+    settings.setValue(r.hash + "/version", r.version);
+    settings.setValue(r.hash + "/size", r.size);
+    settings.setValue(r.hash + "/last_used", r.lastUsed);
+}
+
+QString FirmwareStore::add(QByteArray image, QString product, QString version)
+{
+    if(image.isEmpty())
+        return QString();
+    QString h = hash(image);
+    QMutexLocker locker(&mutex);
+    //the same content is written once whatever it is called
+    if(!index.contains(h))
+    {
+        QSaveFile f(path(h));
+        if(!f.open(QIODevice::WriteOnly) || f.write(image) != image.length() || !f.commit())
+            return QString();
+    }
+    Record r = index.value(h);
+    r.hash = h;
+    r.size = image.length();
+    if(!product.isEmpty())
+        r.product = product;
+    if(!version.isEmpty())
+        r.version = version;
+    r.lastUsed = QDateTime::currentDateTimeUtc();
+    index.insert(h, r);
+    writeRecord(r);
+    evict();
+    return h;
+}
+
+bool FirmwareStore::contains(QString hash)
+{
+    QMutexLocker locker(&mutex);
+    return index.contains(hash);
+}
+
+FirmwareStore::Record FirmwareStore::record(QString hash)
+{
+    QMutexLocker locker(&mutex);
+    return index.value(hash);
+}
+
+FirmwareStore::Record FirmwareStore::latest(QString product)
+{
+    QMutexLocker locker(&mutex);
+    Record latest;
+    for(Record r : index)
+    {
+        if(r.product == product && (latest.hash.isEmpty() || r.lastUsed > latest.lastUsed))
+            latest = r;
+    }
+    return latest;
+}
+
+QList<FirmwareStore::Record> FirmwareStore::records()
+{
+    QMutexLocker locker(&mutex);
+    return index.values();
+}
+
+FirmwareStore::Mapping FirmwareStore::image(QString hash)
+{
+    QMutexLocker locker(&mutex);
+    Mapping mapping;
+    if(!index.contains(hash))
+        return mapping;
+    QSharedPointer<QFile> f(new QFile(path(hash)));
+    uchar *data = f->open(QIODevice::ReadOnly) ? f->map(0, f->size()) : nullptr;
+    if(data == nullptr)
+        return mapping;
+    //deleting the file unmaps it, evicting the image only unlinks it meanwhile
+    mapping.file = f;
+    mapping.view = QByteArray::fromRawData((const char *)data, f->size());
+    return mapping;
+}
+
+void FirmwareStore::touch(QString hash)
+{
+    QMutexLocker locker(&mutex);
+    if(!index.contains(hash))
+        return;
+    index[hash].lastUsed = QDateTime::currentDateTimeUtc();
+    writeRecord(index[hash]);
+}
+
+FirmwareStore::Device FirmwareStore::device(QString key)
+{
+    QMutexLocker locker(&mutex);
+    QSettings settings(dir + "/devices.ini", QSettings::IniFormat);
+    Device d;
+    settings.beginGroup(key);
+    d.hash = settings.value("hash").toString();
+    d.version = settings.value("version", -1).toInt();
+    d.flashed = settings.value("flashed").toDateTime();
+    settings.endGroup();
+    return d;
+}
+
+void FirmwareStore::setDevice(QString key, Device d)
+{
+    QMutexLocker locker(&mutex);
+    QSettings settings(dir + "/devices.ini", QSettings::IniFormat);
+    settings.beginGroup(key);
+    settings.setValue("hash", d.hash);
+    settings.setValue("version", d.version);
+    settings.setValue("flashed", d.flashed);
+    settings.endGroup();
+}
+
+void FirmwareStore::evict()
+{
+    qint64 total = 0;
+    for(Record r : index)
+        total += r.size;
+    QSettings settings(dir + "/index.ini", QSettings::IniFormat);
+    //the image just added or used is the most recent one and always stays
+    while(index.count() > 1 && (index.count() > maxImages || total > maxBytes))
+    {
+        Record oldest = index.first();
+        for(Record r : index)
+        {
+            if(r.lastUsed < oldest.lastUsed)
+                oldest = r;
+        }
+        QFile::remove(path(oldest.hash));
+        settings.remove(oldest.hash);
+        index.remove(oldest.hash);
+        total -= oldest.size;
+    }
+}
+
+FirmwareBundle::FirmwareBundle(QByteArray bundle)
+{
+    data = bundle;
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_5_0);
+    quint32 magic = 0, version = 0, count = 0;
+    in >> magic >> version >> count;
+    if(magic != Magic || version != Version)
+        return;
+    QMap<QString, Entry> index;
+    for(quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++)
+    {
+        Entry e;
+        in >> e.product >> e.version >> e.offset >> e.compressed >> e.length;
+        index.insert(e.product, e);
+    }
+    blob = in.device()->pos();
+    if(in.status() != QDataStream::Ok)
+        return;
+    for(Entry e : index)
+    {
+        if(blob + e.offset + e.compressed > data.length())
+            return;
+    }
+    entries = index;
+}
+
+const FirmwareBundle &FirmwareBundle::embedded()
+{
+    static FirmwareBundle bundle([] () -> QByteArray
+    {
+        QResource resource(":/firmware/firmware.bundle");
+        if(!resource.isValid())
+            return QByteArray();
+        //the images are compressed already, rcc normally stores the bundle as it is
+        if(!resource.isCompressed())
+            return QByteArray::fromRawData((const char *)resource.data(), resource.size());
+        QFile f(":/firmware/firmware.bundle");
+        f.open(QIODevice::ReadOnly);
+        return f.readAll();
+    }());
+    return bundle;
+}
+
+QByteArray FirmwareBundle::image(QString product) const
+{
+    if(!entries.contains(product))
+        return QByteArray();
+    Entry e = entries.value(product);
+    QByteArray image = qUncompress((const uchar *)data.constData() + blob + e.offset, e.compressed);
+    if((quint32)image.length() != e.length)
+        return QByteArray();
+    return image;
+}
+
+QByteArray bundledFirmware(QString product)
+{
+    QByteArray image = FirmwareBundle::embedded().image(product);
+    if(!image.isEmpty())
+        return image;
+    //builds without gt-firmware-pack bundle the JSON files instead
+    QFile s(":/data/" + product + ".json");
+    if(!s.open(QIODevice::ReadOnly))
+        return QByteArray();
+    image = decodeData(s.readAll());
+    s.close();
+    return image;
+}
+
+int firmwareDescriptor(QByteArray image)
+{
+    if(image.isEmpty())
+        return -1;
+    int fd = -1;
+#if defined(Q_OS_LINUX) && defined(SYS_memfd_create)
+    fd = (int)syscall(SYS_memfd_create, "gt-firmware", MFD_CLOEXEC);
+#endif
+#ifdef Q_OS_WIN
+    if(fd < 0)
+    {
+        //a unique name made by the system, removed by it when the last handle is closed
+        char dir[MAX_PATH + 1];
+        char name[MAX_PATH + 1];
+        if(GetTempPathA(sizeof(dir), dir) > 0 && GetTempFileNameA(dir, "gtf", 0, name) != 0)
+        {
+            HANDLE handle = CreateFileA(name, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                        nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+            if(handle != INVALID_HANDLE_VALUE)
+            {
+                fd = _open_osfhandle((intptr_t)handle, _O_RDWR | _O_BINARY);
+                if(fd < 0)
+                    CloseHandle(handle);
+            }
+            else
+                DeleteFileA(name);
+        }
+    }
+#else
+    if(fd < 0)
+    {
+        QByteArray name = QDir::tempPath().toLocal8Bit() + "/gt-firmware-XXXXXX";
+        fd = mkstemp(name.data());
+        if(fd >= 0)
+            unlink(name.constData());
+    }
+#endif
+    if(fd < 0)
+        return -1;
+    qint64 written = 0;
+    while(written < image.length())
+    {
+        int n = (int)write(fd, image.constData() + written, image.length() - written);
+        if(n <= 0)
+        {
+            close(fd);
+            return -1;
+        }
+        written += n;
+    }
+    lseek(fd, 0, SEEK_SET);
+    return fd;
+}
@@ -0,0 +1,227 @@
+#ifndef FIRMWARE_H
+#define FIRMWARE_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QDateTime>
+#include <QSharedPointer>
+#include <QUrl>
+#include <functional>
+
+class QNetworkAccessManager;
+class QFile;
+
+///Online firmware catalog with a persistent cache.
+///Every request goes through one network manager, so connections are kept
+///alive, and is conditional on the ETag/Last-Modified of the cached copy.
+///The list and the images survive restarts and are available at once,
+///refresh() revalidates them in the background.
+class FirmwareCatalog : public QObject
+{
+        Q_OBJECT
+    public:
+        struct Stats
+        {
+            quint64 requests { 0 };
+            ///answered 304, the cached copy was used
+            quint64 notModified { 0 };
+            quint64 downloads { 0 };
+            quint64 bytesDownloaded { 0 };
+            quint64 failures { 0 };
+        };
+
+        FirmwareCatalog(QString cacheDir, QObject *parent = nullptr);
+
+        ///Endpoint of the catalog, GT_FIRMWARE_URL overrides the default
+        void setBaseUrl(QString url);
+        QString baseUrl() const
+        {
+            return base;
+        }
+        void setTimeouts(int list_ms, int image_ms);
+        ///Fetch every image after a refresh
+        void setPrefetch(bool enabled)
+        {
+            prefetch = enabled;
+        }
+        ///Last known products, from the cache until refresh() completes
+        QStringList products();
+        ///Cached image of product, empty if never fetched, safe from any thread
+        QByteArray image(QString product);
+        bool contains(QString product);
+        ///Validator of the cached image, identifies the published revision
+        QString revision(QString product);
+        ///Revalidate the list, emits listChanged() and prefetches the images
+        void refresh();
+        ///Fetch or revalidate the image of product, emits imageReady() or failed()
+        void fetch(QString product);
+        Stats stats();
+
+    signals:
+        void listChanged(QStringList products);
+        void imageReady(QString product);
+        void failed(QString product, QString error);
+
+    private:
+        struct Entry
+        {
+            QString etag;
+            QString lastModified;
+            QByteArray data;
+            bool loaded { false };
+        };
+        ///Conditional GET of url, done receives the decoded data or an error
+        void get(QString key, QUrl url, int timeout_ms, std::function<void(QByteArray, QString)> done);
+        Entry &entry(QString key);
+        void store(QString key, Entry e);
+        QString path(QString key) const;
+
+        QNetworkAccessManager *manager;
+        QString dir;
+        QString base;
+        int list_timeout { 3000 };
+        int image_timeout { 30000 };
+        bool prefetch { true };
+        QHash<QString, Entry> entries;
+        QHash<QString, bool> inflight;
+        QMutex mutex;
+        Stats counters;
+};
+
+///Content-addressed store of firmware images.
+///Raw images are kept as <sha256>.bin next to a small index of product,
+///version, size and last use, the least recently used ones are evicted once
+///the store grows beyond its limits.
+class FirmwareStore
+{
+    public:
+        struct Record
+        {
+            ///SHA-256, hex
+            QString hash;
+            QString product;
+            QString version;
+            qint64 size { 0 };
+            QDateTime lastUsed;
+        };
+
+        ///Last image flashed to a controller
+        struct Device
+        {
+            QString hash;
+            ///firmware version the controller reported afterwards, -1 until known
+            int version { -1 };
+            QDateTime flashed;
+        };
+
+        ///Read-only mapping of a stored image, unmapped when the last copy is released
+        class Mapping
+        {
+            public:
+                ///Valid while this mapping or a copy of it is alive, eviction does not end it
+                QByteArray bytes() const
+                {
+                    return view;
+                }
+                bool isEmpty() const
+                {
+                    return view.isEmpty();
+                }
+
+            private:
+                friend class FirmwareStore;
+                QSharedPointer<QFile> file;
+                QByteArray view;
+        };
+
+        FirmwareStore(QString dir, qint64 maxBytes = 4 * 1024 * 1024, int maxImages = 32);
+        ~FirmwareStore();
+
+        ///Store image and mark it used, returns its hash or an empty string on errors
+        QString add(QByteArray image, QString product, QString version = QString());
+        bool contains(QString hash);
+        Record record(QString hash);
+        ///Most recently used image of product, an empty record if there is none
+        Record latest(QString product);
+        QList<Record> records();
+        ///File of the image, can be flashed as it is
+        QString path(QString hash) const;
+        ///Memory-mapped image, keep the mapping for as long as its bytes are used
+        Mapping image(QString hash);
+        void touch(QString hash);
+        static QString hash(QByteArray image);
+        ///Per-controller records, kept apart from the images and never evicted
+        Device device(QString key);
+        void setDevice(QString key, Device d);
+
+    private:
+        void writeRecord(Record r);
+        void evict();
+
+        QString dir;
+        qint64 maxBytes;
+        int maxImages;
+        QMap<QString, Record> index;
+        QMutex mutex;
+};
+
+///Firmware images compiled into the executable by gt-firmware-pack.
+///A QDataStream header (magic, version, count, then product, version, offset,
+///compressed and inflated length of each image) is followed by one qCompress()
+///stream per image, so selecting an image inflates only that one.
+class FirmwareBundle
+{
+    public:
+        enum
+        {
+            Magic = 0x47544657,
+            Version = 1,
+        };
+        struct Entry
+        {
+            QString product;
+            QString version;
+            ///from the end of the header
+            quint32 offset { 0 };
+            quint32 compressed { 0 };
+            quint32 length { 0 };
+        };
+
+        FirmwareBundle(QByteArray data);
+        ///The bundle in the resources, empty in builds without it
+        static const FirmwareBundle &embedded();
+        bool isValid() const
+        {
+            return !entries.isEmpty();
+        }
+        QStringList products() const
+        {
+            return entries.keys();
+        }
+        Entry entry(QString product) const
+        {
+            return entries.value(product);
+        }
+        ///Inflated image of product, empty if not bundled
+        QByteArray image(QString product) const;
+
+    private:
+        QByteArray data;
+        qint64 blob { 0 };
+        QMap<QString, Entry> entries;
+};
+
+///Firmware image of product bundled in the resources, empty if not bundled
+QByteArray bundledFirmware(QString product);
+///Readable descriptor of image for dfu_flash, -1 on errors, the caller closes it.
+///The image lives in an anonymous memory file (memfd) on Linux, elsewhere in a
+///temporary file that is already unlinked, or deleted on close on Windows, so
+///nothing is left behind.
+int firmwareDescriptor(QByteArray image);
+
+#endif // FIRMWARE_H
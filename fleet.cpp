@@ -0,0 +1,246 @@
+#include "fleet.h"
+#include <cstdio>
+#include <QDateTime>
+#include <QSettings>
+#include <QStringList>
+
+Fleet::Fleet(QString p, QObject *parent) : QObject(parent)
+{
+    program = p;
+}
+
+Fleet::~Fleet()
+{
+    stop();
+    qDeleteAll(entries);
+}
+
+QList<Fleet::Mount> Fleet::load(QString filename)
+{
+    QList<Mount> mounts;
+    QSettings ini(filename, QSettings::IniFormat);
+    for(QString group : ini.childGroups())
+    {
+        ini.beginGroup(group);
+        Mount mount;
+        mount.name = group;
+        mount.port = ini.value("port").toString();
+        mount.profile = ini.value("profile").toString();
+        mount.serverPort = ini.value("server-port", 0).toInt();
+        mount.track = ini.value("track", "none").toString();
+        mount.telemetry_ms = ini.value("telemetry", 1000).toInt();
+        ini.endGroup();
+        if(!mount.port.isEmpty())
+            mounts.append(mount);
+    }
+    return mounts;
+}
+
+void Fleet::add(Mount mount)
+{
+    Slot *slot = new Slot();
+    slot->session.mount = mount;
+    slot->process = new QProcess(this);
+    int index = entries.count();
+    entries.append(slot);
+    connect(slot->process, &QProcess::readyReadStandardOutput, this, [ = ] ()
+    {
+        while(slot->process->canReadLine())
+            parse(index, slot->process->readLine().trimmed());
+    });
+    connect(slot->process, &QProcess::readyReadStandardError, this, [ = ] ()
+    {
+        for(QByteArray line : slot->process->readAllStandardError().split('\n'))
+        {
+            if(!line.trimmed().isEmpty())
+                fprintf(stderr, "[%s] %s\n", slot->session.mount.name.toUtf8().constData(), line.trimmed().constData());
+        }
+    });
+    connect(slot->process, &QProcess::started, this, [ = ] ()
+    {
+        //without telemetry there is no line to tell that the link is up
+        if(slot->session.mount.telemetry_ms <= 0)
+            setState(index, Running);
+    });
+    connect(slot->process, static_cast<void (QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished),
+            this, [ = ] (int, QProcess::ExitStatus)
+    {
+        //a stalled session stays marked so until it is relaunched
+        if(slot->session.state != Stalled)
+            setState(index, Stopped);
+        if(stopping)
+            return;
+        //a link that keeps failing is retried less and less often
+        slot->session.restarts++;
+        slot->RestartJob = scheduler->addOneShot("Fleet restart", slot->backoff_ms, [ = ] ()
+        {
+            slot->RestartJob = -1;
+            if(!stopping)
+                launch(index);
+        }, this);
+        slot->backoff_ms = qMin(slot->backoff_ms * 2, 30000);
+    });
+    if(!stopping)
+        launch(index);
+}
+
+void Fleet::start()
+{
+    if(!stopping)
+        return;
+    stopping = false;
+    //no reactor thread until there is something to supervise
+    if(scheduler == nullptr)
+        scheduler = new Scheduler(this);
+    for(int i = 0; i < entries.count(); i++)
+        launch(i);
+    WatchdogJob = scheduler->addPeriodic("Fleet watchdog", 500, [ = ] ()
+    {
+        watchdog();
+    }, this);
+}
+
+void Fleet::stop()
+{
+    if(stopping)
+        return;
+    stopping = true;
+    scheduler->remove(WatchdogJob);
+    WatchdogJob = -1;
+    for(Slot *slot : entries)
+    {
+        if(slot->RestartJob >= 0)
+            scheduler->remove(slot->RestartJob);
+        slot->RestartJob = -1;
+        if(slot->process->state() == QProcess::NotRunning)
+            continue;
+        //the children stop their motors and links on SIGTERM
+        slot->process->terminate();
+        if(!slot->process->waitForFinished(3000))
+        {
+            slot->process->kill();
+            slot->process->waitForFinished(1000);
+        }
+    }
+}
+
+void Fleet::launch(int index)
+{
+    Slot *slot = entries[index];
+    const Mount &mount = slot->session.mount;
+    QStringList args;
+    args << "--headless" << "--port" << mount.port << "--server-port" << QString::number(mount.serverPort)
+         << "--track" << mount.track << "--telemetry" << QString::number(mount.telemetry_ms);
+    if(!mount.profile.isEmpty())
+        args << "--profile" << mount.profile;
+    slot->lastLine.start();
+    slot->started.start();
+    slot->session.samples = 0;
+    slot->session.meanLatency_ms = 0.0;
+    setState(index, Starting);
+    slot->process->start(program, args);
+}
+
+void Fleet::parse(int index, QByteArray line)
+{
+    Slot *slot = entries[index];
+    QList<QByteArray> fields = line.split(',');
+    if(fields.count() != 9)
+        return;
+    Session *s = &slot->session;
+    s->sampled_ms = fields[0].toLongLong();
+    for(int a = 0; a < 2; a++)
+    {
+        s->axis[a].steps = fields[1 + a * 4].toDouble();
+        s->axis[a].speed = fields[2 + a * 4].toDouble();
+        s->axis[a].speed_stddev = fields[3 + a * 4].toDouble();
+        s->axis[a].running = fields[4 + a * 4].toInt();
+    }
+    //children run on the same host and clock
+    s->lastLatency_ms = qMax(0.0, (double)(QDateTime::currentMSecsSinceEpoch() - s->sampled_ms));
+    s->samples++;
+    s->meanLatency_ms += (s->lastLatency_ms - s->meanLatency_ms) / s->samples;
+    s->maxLatency_ms = qMax(s->maxLatency_ms, s->lastLatency_ms);
+    s->samplesPerSecond = s->samples * 1000.0 / qMax((qint64)1, slot->started.elapsed());
+    slot->lastLine.start();
+    slot->backoff_ms = 1000;
+    setState(index, Running);
+    emit sampled(index);
+}
+
+void Fleet::watchdog()
+{
+    for(int i = 0; i < entries.count(); i++)
+    {
+        Slot *slot = entries[i];
+        //a session without telemetry prints nothing to go by
+        if(slot->process->state() == QProcess::NotRunning || slot->session.mount.telemetry_ms <= 0)
+            continue;
+        //connecting and detecting take a while, a running link misses at most a few lines
+        int timeout_ms = (slot->session.state == Starting ? 30000 : qMax(5000, slot->session.mount.telemetry_ms * 5));
+        if(slot->lastLine.elapsed() < timeout_ms)
+            continue;
+        fprintf(stderr, "[%s] no telemetry for %lld ms, restarting\n", slot->session.mount.name.toUtf8().constData(),
+                (long long)slot->lastLine.elapsed());
+        setState(i, Stalled);
+        //a child stuck in a blocking read does not honour SIGTERM
+        slot->process->kill();
+    }
+}
+
+void Fleet::setState(int index, State state)
+{
+    Slot *slot = entries[index];
+    if(slot->session.state == state)
+        return;
+    slot->session.state = state;
+    emit stateChanged(index, state);
+}
+
+Fleet::Session Fleet::session(int index) const
+{
+    return entries.value(index)->session;
+}
+
+Fleet::Stats Fleet::stats() const
+{
+    Stats stats;
+    double weighted = 0.0;
+    for(Slot *slot : entries)
+    {
+        const Session &s = slot->session;
+        stats.sessions++;
+        stats.running += (s.state == Running);
+        stats.stalled += (s.state == Stalled);
+        stats.restarts += s.restarts;
+        stats.samples += s.samples;
+        if(s.state == Running)
+            stats.samplesPerSecond += s.samplesPerSecond;
+        weighted += s.meanLatency_ms * s.samples;
+        stats.maxLatency_ms = qMax(stats.maxLatency_ms, s.maxLatency_ms);
+    }
+    if(stats.samples > 0)
+        stats.meanLatency_ms = weighted / stats.samples;
+    return stats;
+}
+
+QString Fleet::Stats::text() const
+{
+    return QString("%1/%2 mounts running, %3 stalled, %4 restarts, %5 samples at %6/s, latency %7 ms mean %8 ms max")
+           .arg(running).arg(sessions).arg(stalled).arg(restarts).arg(samples).arg(samplesPerSecond, 0, 'f', 1)
+           .arg(meanLatency_ms, 0, 'f', 1).arg(maxLatency_ms, 0, 'f', 1);
+}
+
+QString Fleet::report() const
+{
+    static const char *states[] = { "stopped", "starting", "running", "stalled" };
+    QStringList lines;
+    for(Slot *slot : entries)
+    {
+        const Session &s = slot->session;
+        lines.append(QString("%1 (%2): %3, %4 restarts, %5 samples at %6/s, latency %7 ms mean %8 ms max")
+                     .arg(s.mount.name).arg(s.mount.port).arg(states[s.state]).arg(s.restarts).arg(s.samples)
+                     .arg(s.samplesPerSecond, 0, 'f', 1).arg(s.meanLatency_ms, 0, 'f', 1).arg(s.maxLatency_ms, 0, 'f', 1));
+    }
+    return lines.join("\n");
+}
@@ -0,0 +1,119 @@
+#ifndef FLEET_H
+#define FLEET_H
+
+#include <QObject>
+#include <QProcess>
+#include <QElapsedTimer>
+#include <QList>
+#include <QString>
+#include "threads.h"
+
+///Runs several mounts from one supervisor. libahp_gt drives a single link per
+///process, so every mount gets its own headless child with its own port, profile,
+///scheduler and telemetry: a slow or hung link only stalls its session, which the
+///watchdog kills and restarts while the others keep going.
+class Fleet : public QObject
+{
+        Q_OBJECT
+    public:
+        enum State
+        {
+            Stopped,
+            Starting,
+            Running,
+            Stalled,
+        };
+        struct Mount
+        {
+            QString name;
+            QString port;
+            ///INI profile, empty for the configurator settings
+            QString profile;
+            ///SynScan server UDP port, 0 disables the server
+            int serverPort { 0 };
+            ///none, ra, dec or both
+            QString track { "none" };
+            ///0 for no telemetry, the session is then not watched for stalls
+            int telemetry_ms { 1000 };
+        };
+        struct AxisSample
+        {
+            double steps { 0.0 };
+            double speed { 0.0 };
+            double speed_stddev { 0.0 };
+            int running { 0 };
+        };
+        struct Session
+        {
+            Mount mount;
+            State state { Stopped };
+            int restarts { 0 };
+            quint64 samples { 0 };
+            ///latest telemetry line of the child
+            qint64 sampled_ms { 0 };
+            AxisSample axis[2];
+            ///from the child sampling to the line being parsed here
+            double lastLatency_ms { 0.0 };
+            double meanLatency_ms { 0.0 };
+            double maxLatency_ms { 0.0 };
+            double samplesPerSecond { 0.0 };
+        };
+        struct Stats
+        {
+            int sessions { 0 };
+            int running { 0 };
+            int stalled { 0 };
+            int restarts { 0 };
+            quint64 samples { 0 };
+            double samplesPerSecond { 0.0 };
+            double meanLatency_ms { 0.0 };
+            double maxLatency_ms { 0.0 };
+            ///one line of totals
+            QString text() const;
+        };
+
+        ///program is started with --headless for every mount
+        Fleet(QString program, QObject *parent = nullptr);
+        ~Fleet();
+
+        ///One mount per INI group, the group name is the mount name
+        static QList<Mount> load(QString filename);
+        void add(Mount mount);
+        void start();
+        void stop();
+        int count() const
+        {
+            return entries.count();
+        }
+        Session session(int index) const;
+        Stats stats() const;
+        ///One line per session
+        QString report() const;
+
+    signals:
+        void sampled(int index);
+        void stateChanged(int index, Fleet::State state);
+
+    private:
+        struct Slot
+        {
+            Session session;
+            QProcess *process { nullptr };
+            QElapsedTimer lastLine;
+            QElapsedTimer started;
+            int backoff_ms { 1000 };
+            int RestartJob { -1 };
+        };
+        void launch(int index);
+        void parse(int index, QByteArray line);
+        void watchdog();
+        void setState(int index, State state);
+
+        QString program;
+        QList<Slot*> entries;
+        Scheduler *scheduler { nullptr };
+        int WatchdogJob { -1 };
+        bool stopping { true };
+};
+
+#endif // FLEET_H
@@ -0,0 +1,610 @@
+#include <cmath>
+#include <cstdio>
+#include <atomic>
+#include <algorithm>
+#include <vector>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QHostAddress>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSettings>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QUdpSocket>
+#include <functional>
+#include <ahp_gt.h>
+#include "profile.h"
+#include "settingsstore.h"
+#include "profilefile.h"
+#include "profilelibrary.h"
+
+///Forwards the datagrams of the library to the target and counts the bytes both ways,
+///the library does not expose its traffic
+class UdpRelay : public QThread
+{
+    public:
+        UdpRelay(QHostAddress address, quint16 port)
+        {
+            target = address;
+            targetPort = port;
+        }
+        ~UdpRelay()
+        {
+            quit();
+            wait();
+        }
+        ///Start relaying, returns the local port to connect to or 0 on errors
+        quint16 open()
+        {
+            start();
+            while(!ready)
+                QThread::msleep(1);
+            return localPort;
+        }
+        quint64 bytes() const
+        {
+            return sent + received;
+        }
+
+    protected:
+        void run() override
+        {
+            QUdpSocket local;
+            QUdpSocket remote;
+            QHostAddress client;
+            quint16 clientPort = 0;
+            if(local.bind(QHostAddress::LocalHost, 0) && remote.bind(QHostAddress::AnyIPv4, 0))
+                localPort = local.localPort();
+            QObject::connect(&local, &QUdpSocket::readyRead, [&] ()
+            {
+                while(local.hasPendingDatagrams())
+                {
+                    QByteArray datagram;
+                    datagram.resize(local.pendingDatagramSize());
+                    local.readDatagram(datagram.data(), datagram.size(), &client, &clientPort);
+                    sent += datagram.size();
+                    remote.writeDatagram(datagram, target, targetPort);
+                }
+            });
+            QObject::connect(&remote, &QUdpSocket::readyRead, [&] ()
+            {
+                while(remote.hasPendingDatagrams())
+                {
+                    QByteArray datagram;
+                    datagram.resize(remote.pendingDatagramSize());
+                    remote.readDatagram(datagram.data(), datagram.size());
+                    received += datagram.size();
+                    if(clientPort)
+                        local.writeDatagram(datagram, client, clientPort);
+                }
+            });
+            ready = true;
+            if(localPort)
+                exec();
+        }
+
+    private:
+        QHostAddress target;
+        quint16 targetPort;
+        quint16 localPort { 0 };
+        std::atomic<bool> ready { false };
+        std::atomic<quint64> sent { 0 };
+        std::atomic<quint64> received { 0 };
+};
+
+struct Result
+{
+    QString name;
+    int runs;
+    double total_s;
+    double mean_us;
+    double p50_us;
+    double p95_us;
+    double p99_us;
+    double max_us;
+    double ops_s;
+    ///-1 when the traffic could not be counted
+    double bytes_s;
+    double bytes_op;
+    ///runs per power-of-two microsecond bucket
+    QList<int> histogram;
+};
+
+static double percentile(const std::vector<double> &sorted, double p)
+{
+    if(sorted.empty())
+        return 0.0;
+    size_t rank = (size_t)ceil(p / 100.0 * sorted.size());
+    return sorted[std::min(sorted.size(), std::max((size_t)1, rank)) - 1];
+}
+
+static Result measure(QString name, int runs, int warmup, UdpRelay *relay, std::function<void()> op)
+{
+    for(int i = 0; i < warmup; i++)
+        op();
+    std::vector<double> samples;
+    samples.reserve(runs);
+    quint64 bytes = relay ? relay->bytes() : 0;
+    QElapsedTimer total;
+    total.start();
+    for(int i = 0; i < runs; i++)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        op();
+        samples.push_back(timer.nsecsElapsed() / 1000.0);
+    }
+    Result r;
+    r.name = name;
+    r.runs = runs;
+    r.total_s = total.nsecsElapsed() / 1000000000.0;
+    //replies may still be in the relay
+    QThread::msleep(relay ? 50 : 0);
+    double traffic = relay ? relay->bytes() - bytes : -1;
+    std::sort(samples.begin(), samples.end());
+    double sum = 0.0;
+    for(double s : samples)
+    {
+        sum += s;
+        int bucket = s < 1.0 ? 0 : (int)floor(log2(s));
+        while(r.histogram.count() <= bucket)
+            r.histogram.append(0);
+        r.histogram[bucket]++;
+    }
+    r.mean_us = runs > 0 ? sum / runs : 0.0;
+    r.p50_us = percentile(samples, 50);
+    r.p95_us = percentile(samples, 95);
+    r.p99_us = percentile(samples, 99);
+    r.max_us = samples.empty() ? 0.0 : samples.back();
+    r.ops_s = r.total_s > 0.0 ? runs / r.total_s : 0.0;
+    r.bytes_s = traffic < 0 ? -1 : traffic / r.total_s;
+    r.bytes_op = traffic < 0 ? -1 : traffic / fmax(1, runs);
+    return r;
+}
+
+static QString format(QList<Result> results, QString kind)
+{
+    QString out;
+    if(kind == "json")
+    {
+        QJsonArray array;
+        for(Result r : results)
+        {
+            QJsonObject obj;
+            obj["operation"] = r.name;
+            obj["runs"] = r.runs;
+            obj["total_s"] = r.total_s;
+            obj["mean_us"] = r.mean_us;
+            obj["p50_us"] = r.p50_us;
+            obj["p95_us"] = r.p95_us;
+            obj["p99_us"] = r.p99_us;
+            obj["max_us"] = r.max_us;
+            obj["ops_per_s"] = r.ops_s;
+            if(r.bytes_s >= 0)
+            {
+                obj["bytes_per_s"] = r.bytes_s;
+                obj["bytes_per_op"] = r.bytes_op;
+            }
+            QJsonArray histogram;
+            for(int count : r.histogram)
+                histogram.append(count);
+            obj["histogram_log2_us"] = histogram;
+            array.append(obj);
+        }
+        return QJsonDocument(array).toJson();
+    }
+    if(kind == "csv")
+    {
+        out = "operation,runs,total_s,mean_us,p50_us,p95_us,p99_us,max_us,ops_per_s,bytes_per_s,bytes_per_op\n";
+        for(Result r : results)
+            out += QString("%1,%2,%3,%4,%5,%6,%7,%8,%9,%10,%11\n").arg(r.name).arg(r.runs).arg(r.total_s).arg(r.mean_us)
+                   .arg(r.p50_us).arg(r.p95_us).arg(r.p99_us).arg(r.max_us).arg(r.ops_s)
+                   .arg(r.bytes_s < 0 ? QString() : QString::number(r.bytes_s))
+                   .arg(r.bytes_op < 0 ? QString() : QString::number(r.bytes_op));
+        return out;
+    }
+    for(Result r : results)
+    {
+        out += QString("%1: %2 runs, p50 %3 us, p95 %4 us, p99 %5 us, max %6 us, %7 ops/s").arg(r.name, -12).arg(r.runs)
+               .arg(r.p50_us, 0, 'f', 0).arg(r.p95_us, 0, 'f', 0).arg(r.p99_us, 0, 'f', 0).arg(r.max_us, 0, 'f', 0).arg(r.ops_s, 0, 'f', 1);
+        if(r.bytes_s >= 0)
+            out += QString(", %1 bytes/s, %2 bytes/op").arg(r.bytes_s, 0, 'f', 0).arg(r.bytes_op, 0, 'f', 1);
+        out += "\n";
+        for(int b = 0; b < r.histogram.count(); b++)
+        {
+            if(r.histogram[b] > 0)
+                out += QString("    < %1 us: %2\n").arg(1 << (b + 1), 8).arg(r.histogram[b]);
+        }
+    }
+    return out;
+}
+
+///The hand-written profile paths the parameter table replaced, kept to compare against
+static Profile legacyLoad(QString ini)
+{
+    Profile p;
+    QSettings settings(ini, QSettings::Format::IniFormat);
+    p.notes = QByteArray::fromBase64(settings.value("Notes").toString().toUtf8());
+    p.address = settings.value("Address", 0).toInt();
+    p.pwm_frequency = settings.value("PWMFreq", ahp_gt_get_pwm_frequency(0)).toInt();
+    p.mount_type = settings.value("MountType", 0).toInt();
+    p.mount_style = settings.value("MountStyle", 0).toInt();
+    p.high_bauds = settings.value("HighBauds", false).toBool();
+    p.half_current = settings.value("HalfCurrent", false).toBool();
+    p.ra = settings.value("Ra", 0).toDouble();
+    p.dec = settings.value("Dec", 0).toDouble();
+    p.latitude = settings.value("Latitude", 0).toDouble();
+    p.longitude = settings.value("Longitude", 0).toDouble();
+    p.last_port = settings.value("LastPort", "").toString();
+    for(int a = 0; a < 2; a++)
+    {
+        AxisProfile &axis = p.axis[a];
+        QString n = QString::number(a);
+        axis.motor_steps = settings.value("MotorSteps_" + n, ahp_gt_get_motor_steps(a)).toInt();
+        axis.motor = settings.value("Motor_" + n, ahp_gt_get_motor_teeth(a)).toInt();
+        axis.worm = settings.value("Worm_" + n, ahp_gt_get_worm_teeth(a)).toInt();
+        axis.crown = settings.value("Crown_" + n, ahp_gt_get_crown_teeth(a)).toInt();
+        axis.max_speed = settings.value("MaxSpeed_" + n, ahp_gt_get_max_speed(a) * SIDEREAL_DAY / M_PI / 2).toInt();
+        axis.acceleration = settings.value("Acceleration_" + n,
+                                           PROFILE_ACCELERATION_MAX - ahp_gt_get_acceleration_angle(a) * 1800.0 / M_PI).toInt();
+        axis.invert = settings.value("Invert_" + n, ahp_gt_get_direction_invert(a) == 1).toBool();
+        axis.inductance = settings.value("Inductance_" + n, 10).toInt();
+        axis.resistance = settings.value("Resistance_" + n, 20000).toInt();
+        axis.current = settings.value("Current_" + n, 1000).toInt();
+        axis.voltage = settings.value("Voltage_" + n, 12).toInt();
+        axis.gpio = settings.value("GPIO_" + n, ahp_gt_get_feature(a)).toInt();
+        axis.coil = settings.value("Coil_" + n, ahp_gt_get_stepping_conf(a)).toInt();
+        axis.stepping_mode = settings.value("SteppingMode_" + n, ahp_gt_get_stepping_mode(a)).toInt();
+        axis.mean = settings.value("Mean_" + n, 1).toInt();
+        axis.estimator = settings.value("Estimator_" + n, 0).toInt();
+        axis.timing = settings.value("Timing_" + n, 0).toInt();
+    }
+    return p;
+}
+
+static void legacyApply(const Profile &p)
+{
+    int flags = ahp_gt_get_mount_flags();
+    int features = ahp_gt_get_features(0);
+    features &= ~(isAZEQ | hasHalfCurrentTracking);
+    features |= hasCommonSlewStart;
+    features |= (p.half_current ? hasHalfCurrentTracking : 0);
+    features |= (p.mount_style == 2 ? isAZEQ : 0);
+    flags &= ~isForkMount;
+    flags &= ~bauds_115200;
+    flags |= (p.mount_style == 1 ? isForkMount : 0);
+    flags |= halfCurrentRA;
+    flags |= halfCurrentDec;
+    ahp_gt_set_mount_flags((GTFlags)flags);
+    ahp_gt_set_mount_type((MountType)mounttypes.value(p.mount_type, mounttypes[0]));
+    ahp_gt_set_features(0, (SkywatcherFeature)features);
+    ahp_gt_set_features(1, (SkywatcherFeature)features);
+    ahp_gt_set_pwm_frequency(0, p.pwm_frequency);
+    ahp_gt_set_pwm_frequency(1, p.pwm_frequency);
+    ahp_gt_select_device(p.address);
+    for(int a = 0; a < 2; a++)
+    {
+        const AxisProfile &axis = p.axis[a];
+        ahp_gt_set_timing(a, -axis.timing * 1500000.0 / 10000.0 + 1500000.0);
+        ahp_gt_set_motor_steps(a, axis.motor_steps);
+        ahp_gt_set_motor_teeth(a, axis.motor);
+        ahp_gt_set_worm_teeth(a, axis.worm);
+        ahp_gt_set_crown_teeth(a, axis.crown);
+        ahp_gt_set_direction_invert(a, axis.invert);
+        ahp_gt_set_stepping_conf(a, (GTSteppingConfiguration)axis.coil);
+        ahp_gt_set_stepping_mode(a, (GTSteppingMode)axis.stepping_mode);
+        switch(axis.gpio)
+        {
+            case 0:
+                ahp_gt_set_feature(a, GpioUnused);
+                break;
+            case 1:
+                ahp_gt_set_feature(a, GpioAsST4);
+                break;
+            case 2:
+                ahp_gt_set_feature(a, GpioAsPulseDrive);
+                break;
+            default:
+                break;
+        }
+        ahp_gt_set_max_speed(a, axis.max_speed * M_PI * 2 / SIDEREAL_DAY);
+        ahp_gt_set_acceleration_angle(a, (PROFILE_ACCELERATION_MAX - axis.acceleration) * M_PI / 1800.0);
+    }
+}
+
+static void legacySave(const Profile &p, SettingsStore *settings)
+{
+    for(int a = 0; a < 2; a++)
+    {
+        const AxisProfile &axis = p.axis[a];
+        QString n = QString::number(a);
+        settings->setValue("Invert_" + n, axis.invert != 0);
+        settings->setValue("SteppingMode_" + n, axis.stepping_mode);
+        settings->setValue("MotorSteps_" + n, axis.motor_steps);
+        settings->setValue("Worm_" + n, axis.worm);
+        settings->setValue("Motor_" + n, axis.motor);
+        settings->setValue("Crown_" + n, axis.crown);
+        settings->setValue("Acceleration_" + n, axis.acceleration);
+        settings->setValue("MaxSpeed_" + n, axis.max_speed);
+        settings->setValue("Coil_" + n, axis.coil);
+        settings->setValue("GPIO_" + n, axis.gpio);
+        settings->setValue("Inductance_" + n, axis.inductance);
+        settings->setValue("Resistance_" + n, axis.resistance);
+        settings->setValue("Current_" + n, axis.current);
+        settings->setValue("Voltage_" + n, axis.voltage);
+        settings->setValue("Mean_" + n, axis.mean);
+        settings->setValue("Estimator_" + n, axis.estimator);
+        settings->setValue("Timing_" + n, axis.timing);
+    }
+    settings->setValue("MountType", p.mount_type);
+    settings->setValue("Address", p.address);
+    settings->setValue("PWMFreq", p.pwm_frequency);
+    settings->setValue("MountStyle", p.mount_style);
+    settings->setValue("Notes", QString(p.notes.toUtf8().toBase64()));
+    settings->setValue("Ra", p.ra);
+    settings->setValue("Dec", p.dec);
+    settings->setValue("Latitude", p.latitude);
+    settings->setValue("Longitude", p.longitude);
+}
+
+///Operations that only exercise the configurator and need no controller
+static bool isProfileOp(QString op)
+{
+    return op.startsWith("profile-") || op.startsWith("legacy-") || op.startsWith("binary-") || op.startsWith("library-");
+}
+
+///Profile operations, run against a profile file in dir
+static bool measureProfile(QString op, int n, int w, QString dir, QList<Result> *results)
+{
+    QString ini = dir + "/bench.ini";
+    if(!QFile(ini).exists())
+    {
+        Profile profile = Profile::load(ini);
+        SettingsStore store(ini);
+        profile.save(&store);
+        store.commit();
+    }
+    Profile profile = Profile::load(ini);
+    QString binary = dir + "/bench" BINARY_PROFILE_SUFFIX;
+    BinaryProfile::write(binary, profile);
+    Profile other = profile;
+    other.axis[1].worm++;
+    other.axis[1].timing++;
+    //every run writes the other profile, so no key is skipped as unchanged
+    SettingsStore store(dir + "/bench-save.ini");
+    int run = 0;
+    if(op == "profile-load")
+        results->append(measure(op, n, w, nullptr, [ = ] ()
+        {
+            Profile::load(ini);
+        }));
+    else if(op == "legacy-load")
+        results->append(measure(op, n, w, nullptr, [ = ] ()
+        {
+            legacyLoad(ini);
+        }));
+    else if(op == "profile-save")
+        results->append(measure(op, n, w, nullptr, [&] ()
+        {
+            (run++ % 2 ? other : profile).save(&store);
+        }));
+    else if(op == "legacy-save")
+        results->append(measure(op, n, w, nullptr, [&] ()
+        {
+            legacySave(run++ % 2 ? other : profile, &store);
+        }));
+    else if(op == "profile-apply")
+        results->append(measure(op, n, w, nullptr, [ = ] ()
+        {
+            profile.apply();
+        }));
+    else if(op == "legacy-apply")
+        results->append(measure(op, n, w, nullptr, [ = ] ()
+        {
+            legacyApply(profile);
+        }));
+    else if(op == "binary-load")
+        results->append(measure(op, n, w, nullptr, [ = ] ()
+        {
+            Profile loaded;
+            BinaryProfile::read(binary, &loaded);
+        }));
+    else if(op == "binary-save")
+        results->append(measure(op, n, w, nullptr, [ = ] ()
+        {
+            BinaryProfile::write(binary, profile);
+        }));
+    else if(op.startsWith("library-"))
+    {
+        //a fleet sized library: mount types, addresses, firmwares and gearings spread over the entries
+        ProfileLibrary library(dir + "/bench.library");
+        if(!QFile(library.fileName()).exists())
+        {
+            for(int i = 0; i < 1000; i++)
+            {
+                ProfileLibrary::Entry entry;
+                entry.name = "mount" + QString::number(i);
+                entry.device = "usb-" + QString::number(i % 200);
+                entry.firmware = 0x100 + i % 8;
+                entry.profile = profile;
+                entry.profile.mount_type = i % mounttypes.count();
+                entry.profile.address = i % 16;
+                entry.profile.axis[0].crown = 100 + i % 50;
+                library.add(entry);
+            }
+            library.save();
+        }
+        library.open();
+        ProfileLibrary::Query query;
+        query.mountType = 3;
+        query.firmware = 0x103;
+        query.gearing = ProfileLibrary::gearing(library.entry(3).profile);
+        if(op == "library-open")
+            results->append(measure(op, n, w, nullptr, [&] ()
+            {
+                library.open();
+            }));
+        else if(op == "library-find")
+            results->append(measure(op, n, w, nullptr, [&] ()
+            {
+                library.find(query);
+            }));
+        else if(op == "library-match")
+            results->append(measure(op, n, w, nullptr, [&] ()
+            {
+                library.match("usb-3", 0x103, 3, 3);
+            }));
+        else
+            return false;
+    }
+    else if(op == "profile-diff")
+        results->append(measure(op, n, w, nullptr, [ = ] ()
+        {
+            profile.diff(other);
+        }));
+    else
+        return false;
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("gt-bench");
+    QCommandLineParser parser;
+    parser.setApplicationDescription("GT controller link latency and throughput benchmark");
+    parser.addHelpOption();
+    parser.addPositionalArgument("port", "Serial port or host:port of the controller, not needed for the profile operations.");
+    QCommandLineOption runs("runs", "Runs per operation.", "n", "100");
+    QCommandLineOption warmup("warmup", "Unmeasured runs before each operation.", "n", "3");
+    QCommandLineOption ops("ops", "Comma separated operations: position, status, read, write, "
+                           "profile-load, profile-save, profile-apply, profile-diff and the legacy-load, legacy-save, "
+                           "legacy-apply paths they replaced, binary-load and binary-save for " BINARY_PROFILE_SUFFIX " profiles, "
+                           "library-open, library-find and library-match on a library of 1000 profiles.", "list", "position,status,read,write");
+    QCommandLineOption axis("axis", "Axis to exercise.", "axis", "0");
+    QCommandLineOption kind("format", "Output format: text, csv or json.", "format", "text");
+    QCommandLineOption output("output", "Write the results to a file instead of stdout.", "file");
+    QCommandLineOption direct("no-relay", "Do not count UDP traffic through the local relay.");
+    parser.addOptions({ runs, warmup, ops, axis, kind, output, direct });
+    parser.process(app);
+    QStringList requested;
+    bool offline = true;
+    for(QString op : parser.value(ops).split(','))
+    {
+        requested.append(op.trimmed());
+        offline &= isProfileOp(requested.last());
+    }
+    if(parser.positionalArguments().isEmpty() && !offline)
+        parser.showHelp(1);
+
+    QString port = parser.positionalArguments().value(0);
+    int n = qMax(1, parser.value(runs).toInt());
+    int w = qMax(0, parser.value(warmup).toInt());
+    int a = parser.value(axis).toInt() != 0 ? 1 : 0;
+    UdpRelay *relay = nullptr;
+    int failure = 1;
+    if(offline)
+        failure = 0;
+    else if(port.contains(':'))
+    {
+        QString address = port.split(":")[0];
+        quint16 udpPort = port.split(":")[1].toUShort();
+        if(!parser.isSet(direct))
+        {
+            QHostAddress target(address);
+            if(target.isNull())
+                target = QHostAddress::LocalHost;
+            relay = new UdpRelay(address == "localhost" ? QHostAddress(QHostAddress::LocalHost) : target, udpPort);
+            quint16 local = relay->open();
+            if(local)
+            {
+                address = "127.0.0.1";
+                udpPort = local;
+            }
+            else
+            {
+                delete relay;
+                relay = nullptr;
+            }
+        }
+        failure = ahp_gt_connect_udp(address.toStdString().c_str(), udpPort);
+    }
+    else
+        failure = ahp_gt_connect(port.toUtf8());
+    if(!offline && !failure && !ahp_gt_is_detected())
+    {
+        int percent = 0;
+        ahp_gt_detect_device(&percent);
+    }
+    if(!offline && (failure || !ahp_gt_is_detected()))
+    {
+        fprintf(stderr, "no controller found on %s\n", port.toUtf8().constData());
+        delete relay;
+        return 1;
+    }
+    if(!offline)
+    {
+        ahp_gt_read_values(0);
+        ahp_gt_read_values(1);
+    }
+
+    QTemporaryDir dir;
+    QList<Result> results;
+    for(QString op : requested)
+    {
+        if(isProfileOp(op))
+        {
+            if(!measureProfile(op, n, w, dir.path(), &results))
+                fprintf(stderr, "unknown operation %s\n", op.toUtf8().constData());
+        }
+        else if(op == "position")
+            results.append(measure("get_position", n, w, relay, [ = ] ()
+            {
+                double timestamp;
+                ahp_gt_get_position(a, &timestamp);
+            }));
+        else if(op == "status")
+            results.append(measure("get_status", n, w, relay, [ = ] ()
+            {
+                ahp_gt_get_status(a);
+            }));
+        else if(op == "read")
+            results.append(measure("read_values", n, w, relay, [ = ] ()
+            {
+                ahp_gt_read_values(a);
+            }));
+        else if(op == "write")
+            results.append(measure("write_values", n, w, relay, [ = ] ()
+            {
+                //writes back what was read, the configuration does not change
+                int percent = 0, finished = 0;
+                ahp_gt_write_values(a, &percent, &finished);
+            }));
+        else
+            fprintf(stderr, "unknown operation %s\n", op.toUtf8().constData());
+    }
+    if(!offline)
+        ahp_gt_disconnect();
+    delete relay;
+
+    QString text = format(results, parser.value(kind));
+    if(parser.isSet(output))
+    {
+        QFile file(parser.value(output));
+        if(!file.open(QIODevice::WriteOnly))
+        {
+            fprintf(stderr, "cannot write %s\n", parser.value(output).toUtf8().constData());
+            return 1;
+        }
+        file.write(text.toUtf8());
+        file.close();
+    }
+    else
+        fprintf(stdout, "%s", text.toUtf8().constData());
+    return 0;
+}
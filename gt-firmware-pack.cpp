@@ -0,0 +1,71 @@
+#include <cstdio>
+#include <QBuffer>
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStringList>
+#include "firmware.h"
+
+///Packs the firmware JSON files into the compressed bundle embedded by the
+///configurator, see FirmwareBundle for the layout
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QStringList args = app.arguments();
+    if(args.count() < 3)
+    {
+        fprintf(stderr, "usage: %s <bundle> <firmware.json>...\n", argv[0]);
+        return 1;
+    }
+    QList<FirmwareBundle::Entry> entries;
+    QByteArray blob;
+    for(QString filename : args.mid(2))
+    {
+        QFile file(filename);
+        if(!file.open(QIODevice::ReadOnly))
+        {
+            fprintf(stderr, "cannot read %s\n", filename.toUtf8().constData());
+            return 1;
+        }
+        QJsonObject obj = QJsonDocument::fromJson(file.readAll()).object();
+        file.close();
+        QByteArray image = QByteArray::fromBase64(obj["data"].toString().toUtf8());
+        if(image.isEmpty())
+        {
+            fprintf(stderr, "no firmware in %s\n", filename.toUtf8().constData());
+            return 1;
+        }
+        //one stream per image, a selection only inflates its own
+        QByteArray compressed = qCompress(image, 9);
+        FirmwareBundle::Entry e;
+        e.product = QFileInfo(filename).completeBaseName();
+        e.version = obj["time"].toString();
+        e.offset = blob.length();
+        e.compressed = compressed.length();
+        e.length = image.length();
+        entries.append(e);
+        blob.append(compressed);
+    }
+    QByteArray header;
+    QBuffer buffer(&header);
+    buffer.open(QIODevice::WriteOnly);
+    QDataStream out(&buffer);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << (quint32)FirmwareBundle::Magic << (quint32)FirmwareBundle::Version << (quint32)entries.count();
+    for(FirmwareBundle::Entry e : entries)
+        out << e.product << e.version << e.offset << e.compressed << e.length;
+    buffer.close();
+    QSaveFile bundle(args.at(1));
+    if(!bundle.open(QIODevice::WriteOnly) || bundle.write(header) != header.length() ||
+            bundle.write(blob) != blob.length() || !bundle.commit())
+    {
+        fprintf(stderr, "cannot write %s\n", args.at(1).toUtf8().constData());
+        return 1;
+    }
+    fprintf(stdout, "%d images, %d bytes\n", entries.count(), header.length() + blob.length());
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include <csignal>
+#include <cstdio>
+#include <atomic>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTimer>
+#include "simulator.h"
+
+static std::atomic<int> quitRequested(0);
+
+static void requestQuit(int)
+{
+    quitRequested = 1;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("gt-simulator");
+    QCommandLineParser parser;
+    parser.setApplicationDescription("GT controller simulator speaking the SkyWatcher motor protocol");
+    parser.addHelpOption();
+    SimulatorConfig config;
+    QCommandLineOption udp("udp-port", "UDP port to listen on, 0 disables UDP.", "port", "11880");
+    QCommandLineOption pty("pty", "Also serve a pseudo terminal, its name is printed on stdout.");
+    QCommandLineOption cpr("cpr", "Microsteps per axis revolution.", "steps", QString::number(config.cpr));
+    QCommandLineOption timer("timer-frequency", "Step timer frequency, Hz.", "hz", QString::number(config.timerFrequency));
+    QCommandLineOption ratio("high-speed-ratio", "High speed ratio.", "ratio", QString::number(config.highSpeedRatio));
+    QCommandLineOption worm("worm-teeth", "Worm wheel teeth.", "teeth", QString::number(config.wormTeeth));
+    QCommandLineOption acceleration("acceleration", "Acceleration, degrees per second squared.", "deg/s2", QString::number(config.acceleration));
+    QCommandLineOption speed("max-speed", "Maximum speed, multiple of sidereal.", "x", QString::number(config.maxSpeed));
+    QCommandLineOption pe("periodic-error", "Worm periodic error amplitude, arcseconds.", "arcsec", QString::number(config.periodicError));
+    QCommandLineOption version("version", "Firmware version answered to :e, hex.", "hex", QString::number(config.version, 16));
+    QCommandLineOption latency("latency", "One-way link latency, ms.", "ms", QString::number(config.latency_ms));
+    QCommandLineOption bandwidth("bandwidth", "Link bandwidth, bytes per second, 0 for unlimited.", "bytes/s", QString::number(config.bandwidth));
+    QCommandLineOption loss("loss", "Probability of losing a request.", "p", QString::number(config.loss));
+    QCommandLineOption seed("seed", "Seed of the packet loss generator.", "n", QString::number(config.seed));
+    QCommandLineOption http("http-port", "Also serve the firmware catalog over HTTP, 0 disables it.", "port", "0");
+    QCommandLineOption firmware("firmware-dir", "Directory of the firmware JSON files served over HTTP.", "dir", ".");
+    parser.addOptions({ udp, pty, http, firmware, cpr, timer, ratio, worm, acceleration, speed, pe, version, latency, bandwidth, loss, seed });
+    parser.process(app);
+
+    config.cpr = parser.value(cpr).toUInt();
+    config.timerFrequency = parser.value(timer).toUInt();
+    config.highSpeedRatio = parser.value(ratio).toUInt();
+    config.wormTeeth = qMax(1, parser.value(worm).toInt());
+    config.acceleration = parser.value(acceleration).toDouble();
+    config.maxSpeed = parser.value(speed).toDouble();
+    config.periodicError = parser.value(pe).toDouble();
+    config.version = parser.value(version).toUInt(nullptr, 16);
+    config.latency_ms = parser.value(latency).toInt();
+    config.bandwidth = parser.value(bandwidth).toInt();
+    config.loss = parser.value(loss).toDouble();
+    config.seed = parser.value(seed).toUInt();
+
+    Simulator simulator(config);
+    int port = parser.value(udp).toInt();
+    if(port > 0 && !simulator.listenUdp(port))
+    {
+        fprintf(stderr, "cannot bind UDP port %d\n", port);
+        return 1;
+    }
+    if(parser.isSet(pty))
+    {
+        QString name = simulator.openPty();
+        if(name.isEmpty())
+        {
+            fprintf(stderr, "cannot open a pseudo terminal\n");
+            return 1;
+        }
+        fprintf(stdout, "%s\n", name.toUtf8().constData());
+        fflush(stdout);
+    }
+    //point GT_FIRMWARE_URL to http://localhost:<port>/firmware.php
+    FirmwareServer server(parser.value(firmware));
+    int httpPort = parser.value(http).toInt();
+    if(httpPort > 0 && !server.listen(httpPort))
+    {
+        fprintf(stderr, "cannot listen on TCP port %d\n", httpPort);
+        return 1;
+    }
+    signal(SIGINT, requestQuit);
+    signal(SIGTERM, requestQuit);
+    QTimer watch;
+    QObject::connect(&watch, &QTimer::timeout, &app, [ & ] ()
+    {
+        if(quitRequested)
+            QCoreApplication::quit();
+    });
+    watch.start(200);
+    int ret = app.exec();
+    Simulator::Stats stats = simulator.stats();
+    fprintf(stderr, "%llu requests, %llu dropped, %llu bytes in, %llu bytes out\n",
+            (unsigned long long)stats.requests, (unsigned long long)stats.dropped,
+            (unsigned long long)stats.bytesIn, (unsigned long long)stats.bytesOut);
+    if(httpPort > 0)
+    {
+        FirmwareServer::Stats served = server.stats();
+        fprintf(stderr, "%llu HTTP requests over %llu connections, %llu not modified, %llu bytes out\n",
+                (unsigned long long)served.requests, (unsigned long long)served.connections,
+                (unsigned long long)served.notModified, (unsigned long long)served.bytesOut);
+    }
+    return ret;
+}
@@ -1,20 +1,36 @@
-#include "mainwindow.h"
 #include <config.h>
+#include <cstring>
+#include <QElapsedTimer>
+#include "daemon.h"
+#include "trace.h"
 
+#ifndef GT_HEADLESS
+#include "mainwindow.h"
 #include <QApplication>
+#endif
 
 #ifdef _WIN32
 #include <windows.h>
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine, INT nCmdShow)
 {
+    QElapsedTimer uptime;
+    uptime.start();
     int argc = 0;
     char **argv = {NULL};
-    QApplication a(argc, argv);
 #else
 int main(int argc, char *argv[])
 {
-    QApplication a(argc, argv);
+    QElapsedTimer uptime;
+    uptime.start();
 #endif
+    Trace::startFromEnvironment();
+#ifdef GT_HEADLESS
+    return Daemon::exec(argc, argv, uptime);
+#else
+    for(int i = 1; i < argc; i++)
+        if(!strcmp(argv[i], "--headless"))
+            return Daemon::exec(argc, argv, uptime);
+    QApplication a(argc, argv);
     MainWindow w;
     w.setWindowTitle(w.getWindowTitle());
     QFont font = w.font();
@@ -22,5 +38,8 @@ int main(int argc, char *argv[])
     w.setFont(font);
     w.show();
     a.setWindowIcon(QIcon(":/icons/icon.ico"));
-    return a.exec();
+    int ret = a.exec();
+    Trace::stop();
+    return ret;
+#endif
 }
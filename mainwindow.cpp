@@ -3,10 +3,6 @@
 #include <ctime>
 #include <cmath>
 #include <cstring>
-#include <QNetworkAccessManager>
-#include <QNetworkReply>
-#include <QJsonDocument>
-#include <QJsonObject>
 #include <QStandardPaths>
 #include <QIODevice>
 #include <functional>
@@ -14,13 +10,16 @@
 #include <QSerialPort>
 #include <QSerialPortInfo>
 #include <QFileDialog>
+#include <QFileInfo>
+#include <QInputDialog>
+#include <QMenu>
+#include <QApplication>
+#include <QShortcut>
 #include <QTimer>
 #include <QMutex>
 #include <errno.h>
 #include <libdfu.h>
 #include "./ui_mainwindow.h"
-static const double SIDEREAL_DAY = 86164.0916000;
-static const double SIDEREAL_NOON = (SIDEREAL_DAY / 2);
 static MountType mounttype[] =
 {
     isEQ6,
@@ -37,143 +36,162 @@ static MountType mounttype[] =
     isCustom,
 };
 
-static QList<int> mounttypes({
-    ///Sky-Watcher EQ6
-    0x00,
-    ///Sky-Watcher HEQ5
-    0x01,
-    ///Sky-Watcher EQ5
-    0x02,
-    ///Sky-Watcher EQ3
-    0x03,
-    ///Sky-Watcher EQ8
-    0x04,
-    ///Sky-Watcher AZEQ6
-    0x05,
-    ///Sky-Watcher AZEQ5
-    0x06,
-    ///Sky-Watcher GT
-    0x80,
-    ///Fork Mount
-    0x81,
-    ///114GT
-    0x82,
-    ///Dobsonian mount
-    0x90,
-    ///Custom mount
-    0xF0,
-});
+///Key of the controller on port, the USB serial number follows it from port to port
+const int base_timing = 1500000;
+const int offset_timing = 1500000>>4;
 
-char *strrand(int len)
+void MainWindow::genFirmware()
 {
-    int i;
-    char* ret = (char*)malloc(len+1);
-    for(i = 0; i < len; i++)
-        ret[i] = 'a' + (rand() % 21);
-    ret[i] = 0;
-    return ret;
+    TRACE_SCOPE("genFirmware");
+    QString product = ui->FW_List->currentText();
+    QString version;
+    QByteArray image;
+    firmwareImage.clear();
+    firmwareMapping = FirmwareStore::Mapping();
+    if(online_resource) {
+        //prefetched by the catalog, nothing is downloaded here
+        image = catalog->image(product);
+        version = catalog->revision(product);
+        if(image.isEmpty()) {
+            //flashed before, mapped from the store, never an image of another product
+            FirmwareStore::Record record = firmwareStore->latest(product);
+            if(!record.hash.isEmpty()) {
+                firmwareMapping = firmwareStore->image(record.hash);
+                image = firmwareMapping.bytes();
+                version = record.version;
+            }
+        }
+    }
+    if(image.isEmpty()) {
+        product = ui->FW_List->currentText();
+        image = bundledFirmware(product);
+        version = FirmwareBundle::embedded().entry(product).version;
+        if(version.isEmpty())
+            version = "bundled";
+    }
+    if(image.isEmpty()) {
+        QMetaObject::invokeMethod(this, [ = ] ()
+        {
+            ui->statusbar->showMessage("No firmware image for " + product + ", not flashed");
+        }, Qt::QueuedConnection);
+        return;
+    }
+    firmwareImage = image;
+    firmwareProduct = product;
+    firmwareVersion = version;
+    ui->Connection->setEnabled(false);
+    ui->Control->setEnabled(false);
+    ui->commonSettings->setEnabled(false);
+    ui->AdvancedRA->setEnabled(false);
+    ui->AdvancedDec->setEnabled(false);
 }
 
-const int base_timing = 1500000;
-const int offset_timing = 1500000>>4;
-
-QStringList MainWindow::CheckFirmware(QString url, int timeout_ms)
+int MainWindow::deviceFirmwareVersion(QString port)
 {
-    QByteArray list;
-    QJsonDocument doc;
-    QNetworkAccessManager* manager = new QNetworkAccessManager();
-    QNetworkReply *response = manager->get(QNetworkRequest(QUrl(url)));
-    QTimer timer;
-    timer.setSingleShot(true);
-    QEventLoop loop;
-    connect(&timer, SIGNAL(timeout()), &loop, SLOT(quit()));
-    connect(response, SIGNAL(finished()), &loop, SLOT(quit()));
-    timer.start(timeout_ms);
-    loop.exec();
-    QString base64 = "";
-    if(response->error() == QNetworkReply::NetworkError::NoError) {
-        QJsonDocument doc = QJsonDocument::fromJson(response->readAll());
-        QJsonObject obj = doc.object();
-        base64 = obj["data"].toString();
+    //a running controller reports its firmware, one in the bootloader does not answer
+    bool wasConnected = TRACED(ahp_gt_is_connected());
+    if(!wasConnected)
+    {
+        int failure = 1;
+        if(port.contains(':'))
+            failure = TRACED(ahp_gt_connect_udp(port.split(":")[0].toStdString().c_str(), port.split(":")[1].toInt()));
+        else
+            failure = TRACED(ahp_gt_connect(port.toUtf8()));
+        if(failure)
+            return -1;
     }
-    if(base64.isNull() || base64.isEmpty()) {
-        goto ck_end;
+    int version = -1;
+    if(!TRACED(ahp_gt_is_detected()))
+    {
+        int progress = 0;
+        TRACED(ahp_gt_detect_device(&progress));
     }
-    list = QByteArray::fromBase64(base64.toUtf8());
-    doc = QJsonDocument::fromJson(list.toStdString().c_str());
-    response->deleteLater();
-    response->manager()->deleteLater();
-    return doc.toVariant().toStringList();
-ck_end:
-    response->deleteLater();
-    response->manager()->deleteLater();
-    return QStringList();
+    if(TRACED(ahp_gt_is_detected()))
+        version = TRACED(ahp_gt_get_mc_version());
+    if(!wasConnected)
+        TRACED(ahp_gt_disconnect());
+    return version;
 }
 
-bool MainWindow::DownloadFirmware(QString url, QString filename, QSettings *settings, int timeout_ms)
+MainWindow::FlashResult MainWindow::flashDevice(QString port, const QByteArray &image, bool force, int *progress, int *done, QString *error)
 {
-    QByteArray bin;
-    QFile file(filename);
-    QNetworkAccessManager* manager = new QNetworkAccessManager();
-    QNetworkReply *response = manager->get(QNetworkRequest(QUrl(url)));
-    QTimer timer;
-    timer.setSingleShot(true);
-    QEventLoop loop;
-    connect(&timer, SIGNAL(timeout()), &loop, SLOT(quit()));
-    connect(response, SIGNAL(finished()), &loop, SLOT(quit()));
-    timer.start(timeout_ms);
-    loop.exec();
-    QString base64 = settings->value("firmware", "").toString();
-    if(response->error() == QNetworkReply::NetworkError::NoError) {
-        QJsonDocument doc = QJsonDocument::fromJson(response->readAll());
-        QJsonObject obj = doc.object();
-        base64 = obj["data"].toString();
+    QString device = DeviceCache::deviceKey(port);
+    QString hash = FirmwareStore::hash(image);
+    FirmwareStore::Device installed = firmwareStore->device(device);
+    //only asked when this image was flashed here before, the version tells whether it is still there
+    if(!force && installed.hash == hash && installed.version >= 0 && deviceFirmwareVersion(port) == installed.version)
+    {
+        *progress = 100;
+        *done = 1;
+        return FlashIdentical;
     }
-    if(base64.isNull() || base64.isEmpty()) {
-        goto dl_end;
+    int fd = firmwareDescriptor(image);
+    if(fd < 0)
+    {
+        *error = "cannot stage the image";
+        return FlashError;
     }
-    bin = QByteArray::fromBase64(base64.toUtf8());
-    file.open(QIODevice::WriteOnly);
-    file.write(bin, bin.length());
-    file.close();
-dl_end:
-    response->deleteLater();
-    response->manager()->deleteLater();
-    if(!QFile::exists(filename)) return false;
-    return true;
+    int ret = TRACED(dfu_flash(fd, progress, done));
+    close(fd);
+    if(ret)
+    {
+        *error = "dfu_flash returned " + QString::number(ret);
+        return FlashError;
+    }
+    firmwareStore->add(image, firmwareProduct, firmwareVersion);
+    FirmwareStore::Device flashed;
+    flashed.hash = hash;
+    flashed.flashed = QDateTime::currentDateTimeUtc();
+    firmwareStore->setDevice(device, flashed);
+    return FlashDone;
 }
 
-void MainWindow::genFirmware()
+void MainWindow::discoverPorts()
 {
-    if(online_resource) {
-        QString url = "https://www.iliaplatone.com/firmware.php?download=yes&product="+ui->FW_List->currentText();
-        DownloadFirmware(url, firmwareFilename, settings);
-    } else {
-        QFile f(firmwareFilename);
-        QFile s(":/data/"+ui->FW_List->currentText()+".json");
-        s.open(QIODevice::ReadOnly);
-        QJsonDocument doc = QJsonDocument::fromJson(s.readAll());
-        s.close();
-        QJsonObject obj = doc.object();
-        QString base64 = obj["data"].toString();
-        if(base64.isNull() || base64.isEmpty()) {
-            goto dl_end;
+    if(discovery->isRunning())
+        return;
+    QElapsedTimer scan;
+    scan.start();
+    disconnect(discovery, &PortDiscovery::finished, this, nullptr);
+    connect(discovery, &PortDiscovery::finished, this, [ = ] ()
+    {
+        if(isConnected)
+            return;
+        QList<PortDiscovery::Result> results = discovery->results();
+        QStringList listed;
+        for(int i = 0; i < ui->ComPort->count(); i++)
+            listed.append(ui->ComPort->itemText(i));
+        QString selected = ui->ComPort->currentText();
+        QStringList found;
+        ui->ComPort->clear();
+        for(PortDiscovery::Result r : results)
+        {
+            if(!r.detected)
+                continue;
+            ui->ComPort->addItem(r.port);
+            ui->ComPort->setItemData(ui->ComPort->count() - 1, r.mountName() + " mount, firmware " + r.firmware() + ", " +
+                                     (r.baud > 0 ? QString::number(r.baud) + " baud, " : "") +
+                                     QString::number(r.latency_ms, 'f', 0) + " ms", Qt::ToolTipRole);
+            found.append(r.port + " (" + r.mountName() + " " + r.firmware() + ")");
+            listed.removeAll(r.port);
         }
-        f.open(QIODevice::WriteOnly);
-        f.write(QByteArray::fromBase64(base64.toUtf8()));
-        f.close();
-    }
-    ui->Connection->setEnabled(false);
-    ui->Control->setEnabled(false);
-    ui->commonSettings->setEnabled(false);
-    ui->AdvancedRA->setEnabled(false);
-    ui->AdvancedDec->setEnabled(false);
-dl_end:
-    return;
+        if(!found.isEmpty())
+            listed.removeAll("No serial ports available");
+        ui->ComPort->addItems(listed);
+        //the fastest controller found is the most likely one
+        ui->ComPort->setCurrentIndex(found.isEmpty() ? qMax(0, ui->ComPort->findText(selected)) : 0);
+        if(found.isEmpty())
+            ui->statusbar->showMessage("No controller answered on " + QString::number(results.count()) + " ports in " +
+                                       QString::number(scan.elapsed()) + " ms");
+        else
+            ui->statusbar->showMessage("Found " + found.join(", ") + " in " + QString::number(scan.elapsed()) + " ms");
+    });
+    discovery->start(PortDiscovery::candidates(QStringList() << settings->value("LastPort", "").toString() << "localhost:11880"));
 }
 
 void MainWindow::readIni(QString ini)
 {
+    TRACE_SCOPE("readIni");
     QString dir = QDir(ini).dirName();
     if(!QDir(dir).exists())
     {
@@ -186,124 +204,50 @@ void MainWindow::readIni(QString ini)
         f->close();
         f->~QFile();
     }
-    QSettings *settings = new QSettings(ini, QSettings::Format::IniFormat);
-    ui->Notes->setText(QByteArray::fromBase64(settings->value("Notes").toString().toUtf8()));
-
-    ui->Address->setValue(settings->value("Address", 0).toInt());
-    ui->PWMFreq->setValue(settings->value("PWMFreq", ahp_gt_get_pwm_frequency(0)).toInt());
-    ui->PWMFreq->setValue(settings->value("PWMFreq", ahp_gt_get_pwm_frequency(1)).toInt());
-    ui->MountType->setCurrentIndex(settings->value("MountType", 0).toInt());
-    ui->MountStyle->setCurrentIndex(settings->value("MountStyle", 0).toInt());
-    ui->HighBauds->setChecked(settings->value("HighBauds", false).toBool());
-    int flags = ahp_gt_get_mount_flags();
-    int features = ahp_gt_get_features(0);
-    features &= ~(isAZEQ | hasHalfCurrentTracking);
-    features |= hasCommonSlewStart;
-    features |= (settings->value("HalfCurrent", false).toBool() ? hasHalfCurrentTracking : 0);
-    flags &= ~isForkMount;
-    flags &= ~bauds_115200;
-    flags |= ((ui->MountStyle->currentIndex() == 1) ? isForkMount : 0);
-    //flags |= (ui->HighBauds->isChecked() ? bauds_115200 : 0);
-    flags |= halfCurrentRA;
-    flags |= halfCurrentDec;
-    ahp_gt_set_mount_flags((GTFlags)flags);
-    ahp_gt_set_mount_type((MountType)mounttypes[ui->MountType->currentIndex()]);
-    ahp_gt_set_features(0, (SkywatcherFeature)(features | ((ui->MountStyle->currentIndex() == 2) ? isAZEQ : 0)));
-    ahp_gt_set_features(1, (SkywatcherFeature)(features | ((ui->MountStyle->currentIndex() == 2) ? isAZEQ : 0)));
-    ahp_gt_set_pwm_frequency(0, ui->PWMFreq->value());
-    ahp_gt_set_pwm_frequency(1, ui->PWMFreq->value());
-    ahp_gt_select_device(ui->Address->value());
-
-
-    ui->MotorSteps_0->setValue(settings->value("MotorSteps_0", ahp_gt_get_motor_steps(0)).toInt());
-    ui->Motor_0->setValue(settings->value("Motor_0", ahp_gt_get_motor_teeth(0)).toInt());
-    ui->Worm_0->setValue(settings->value("Worm_0", ahp_gt_get_worm_teeth(0)).toInt());
-    ui->Crown_0->setValue(settings->value("Crown_0", ahp_gt_get_crown_teeth(0)).toInt());
-    ui->MaxSpeed_0->setValue(settings->value("MaxSpeed_0", ahp_gt_get_max_speed(0) * SIDEREAL_DAY / M_PI / 2).toInt());
-    ui->Acceleration_0->setValue(settings->value("Acceleration_0",
-                                 ui->Acceleration_0->maximum() - ahp_gt_get_acceleration_angle(0) * 1800.0 / M_PI).toInt());
-    ui->Invert_0->setChecked(settings->value("Invert_0", ahp_gt_get_direction_invert(0) == 1).toBool());
-    ui->Inductance_0->setValue(settings->value("Inductance_0", 10).toInt());
-    ui->Resistance_0->setValue(settings->value("Resistance_0", 20000).toInt());
-    ui->Current_0->setValue(settings->value("Current_0", 1000).toInt());
-    ui->Voltage_0->setValue(settings->value("Voltage_0", 12).toInt());
-    ui->GPIO_0->setCurrentIndex(settings->value("GPIO_0", ahp_gt_get_feature(0)).toInt());
-    ui->Coil_0->setCurrentIndex(settings->value("Coil_0", ahp_gt_get_stepping_conf(0)).toInt());
-    ui->SteppingMode_0->setCurrentIndex(settings->value("SteppingMode_0", ahp_gt_get_stepping_mode(0)).toInt());
-    ui->Mean_0->setValue(settings->value("Mean_0", 1).toInt());
-    ui->Timing_0->setValue(settings->value("Timing_0", 0).toInt());
-
-    ui->MotorSteps_1->setValue(settings->value("MotorSteps_1", ahp_gt_get_motor_steps(1)).toInt());
-    ui->Motor_1->setValue(settings->value("Motor_1", ahp_gt_get_motor_teeth(1)).toInt());
-    ui->Worm_1->setValue(settings->value("Worm_1", ahp_gt_get_worm_teeth(1)).toInt());
-    ui->Crown_1->setValue(settings->value("Crown_1", ahp_gt_get_crown_teeth(1)).toInt());
-    ui->MaxSpeed_1->setValue(settings->value("MaxSpeed_1", ahp_gt_get_max_speed(1) * SIDEREAL_DAY / M_PI / 2).toInt());
-    ui->Acceleration_1->setValue(settings->value("Acceleration_1",
-                                 ui->Acceleration_1->maximum() - ahp_gt_get_acceleration_angle(1) * 1800.0 / M_PI).toInt());
-    ui->Invert_1->setChecked(settings->value("Invert_1", ahp_gt_get_direction_invert(1) == 1).toBool());
-    ui->Inductance_1->setValue(settings->value("Inductance_1", 10).toInt());
-    ui->Resistance_1->setValue(settings->value("Resistance_1", 20000).toInt());
-    ui->Current_1->setValue(settings->value("Current_1", 1000).toInt());
-    ui->Voltage_1->setValue(settings->value("Voltage_1", 12).toInt());
-    ui->GPIO_1->setCurrentIndex(settings->value("GPIO_1", ahp_gt_get_feature(1)).toInt());
-    ui->Coil_1->setCurrentIndex(settings->value("Coil_1", ahp_gt_get_stepping_conf(1)).toInt());
-    ui->SteppingMode_1->setCurrentIndex(settings->value("SteppingMode_1", ahp_gt_get_stepping_mode(1)).toInt());
-    ui->Mean_1->setValue(settings->value("Mean_1", 1).toInt());
-    ui->Timing_1->setValue(settings->value("Timing_1", 0).toInt());
+    applyProfile(Profile::load(ini), QFileInfo(ini).completeBaseName());
+}
 
-    ahp_gt_set_timing(0, -settings->value("Timing_0", 0).toInt() * 1500000.0 / 10000.0 + 1500000.0);
-    ahp_gt_set_motor_steps(0, ui->MotorSteps_0->value());
-    ahp_gt_set_motor_teeth(0, ui->Motor_0->value());
-    ahp_gt_set_worm_teeth(0, ui->Worm_0->value());
-    ahp_gt_set_crown_teeth(0, ui->Crown_0->value());
-    ahp_gt_set_direction_invert(0, ui->Invert_0->isChecked());
-    ahp_gt_set_stepping_conf(0, (GTSteppingConfiguration)ui->Coil_0->currentIndex());
-    ahp_gt_set_stepping_mode(0, (GTSteppingMode)ui->SteppingMode_0->currentIndex());
-    switch(ui->GPIO_0->currentIndex())
-    {
-        case 0:
-            ahp_gt_set_feature(0, GpioUnused);
-            break;
-        case 1:
-            ahp_gt_set_feature(0, GpioAsST4);
-            break;
-        case 2:
-            ahp_gt_set_feature(0, GpioAsPulseDrive);
-            break;
-        default:
-            break;
+bool MainWindow::applyProfile(Profile profile, QString name)
+{
+    TRACE_SCOPE("applyProfile");
+    Profile current = currentProfile();
+    ProfileTransaction transaction(current);
+    transaction.stage(profile);
+    QStringList invalid = transaction.validate();
+    if(!invalid.isEmpty())
+    {
+        ui->statusbar->showMessage("Profile " + name + " not applied, out of range: " + invalid.join(", "));
+        return false;
     }
+    //the controls only show the staged values, their handlers would push and save them one by one
+    QList<QWidget *> coordinates({ ui->Ra_0, ui->Ra_1, ui->Ra_2, ui->Dec_0, ui->Dec_1, ui->Dec_2,
+                                   ui->Lat_0, ui->Lat_1, ui->Lat_2, ui->Lon_0, ui->Lon_1, ui->Lon_2 });
+    disconnectControls(true);
+    for(QWidget *widget : coordinates)
+        widget->blockSignals(true);
+    ui->Notes->setText(profile.notes);
+    ui->Address->setValue(profile.address);
+    ui->PWMFreq->setValue(profile.pwm_frequency);
+    ui->PWMFreq_label->setText("PWM: " + QString::number(366 + 366 * profile.pwm_frequency) + " Hz");
+    ui->MountType->setCurrentIndex(profile.mount_type);
+    ui->MountStyle->setCurrentIndex(profile.mount_style);
+    ui->HighBauds->setChecked(profile.high_bauds);
 
-    ahp_gt_set_timing(1, -settings->value("Timing_1", 0).toInt() * 1500000.0 / 10000.0 + 1500000.0);
-    ahp_gt_set_motor_steps(1, ui->MotorSteps_1->value());
-    ahp_gt_set_motor_teeth(1, ui->Motor_1->value());
-    ahp_gt_set_worm_teeth(1, ui->Worm_1->value());
-    ahp_gt_set_crown_teeth(1, ui->Crown_1->value());
-    ahp_gt_set_direction_invert(1, ui->Invert_1->isChecked());
-    ahp_gt_set_stepping_conf(1, (GTSteppingConfiguration)ui->Coil_1->currentIndex());
-    ahp_gt_set_stepping_mode(1, (GTSteppingMode)ui->SteppingMode_1->currentIndex());
-    switch(ui->GPIO_1->currentIndex())
-    {
-        case 0:
-            ahp_gt_set_feature(1, GpioUnused);
-            break;
-        case 1:
-            ahp_gt_set_feature(1, GpioAsST4);
-            break;
-        case 2:
-            ahp_gt_set_feature(1, GpioAsPulseDrive);
-            break;
-        default:
-            break;
+    for(int a = 0; a < 2; a++)
+    {
+        for(int i = 0; i < AXIS_PARAMETERS; i++)
+            axisBindings[i].setValue(a, profile.axis[a].*axisParameters[i].field);
     }
-    Ra = settings->value("Ra", 0).toDouble();
-    Dec = settings->value("Dec", 0).toDouble();
-    Latitude = settings->value("Latitude", 0).toDouble();
-    Longitude = settings->value("Longitude", 0).toDouble();
-    double* ra = toDms(Ra);
-    double* dec = toDms(Dec);
-    double* lat = toDms(Latitude);
-    double* lon = toDms(Longitude);
+
+    Ra = profile.ra;
+    Dec = profile.dec;
+    Latitude = profile.latitude;
+    Longitude = profile.longitude;
+    double ra[3], dec[3], lat[3], lon[3];
+    toDms(Ra, ra);
+    toDms(Dec, dec);
+    toDms(Latitude, lat);
+    toDms(Longitude, lon);
 
     ui->Ra_0->setValue(ra[0]);
     ui->Dec_0->setValue(dec[0]);
@@ -317,10 +261,55 @@ void MainWindow::readIni(QString ini)
     ui->Dec_2->setValue(dec[2]);
     ui->Lat_2->setValue(lat[2]);
     ui->Lon_2->setValue(lon[2]);
+    for(QWidget *widget : coordinates)
+        widget->blockSignals(false);
+    disconnectControls(false);
+
+    if(profile.address != current.address)
+        selectAddress(profile.address);
+    transaction.commit(settings);
+    //what the handlers do besides pushing and saving, for the values that changed only
+    for(int a = 0; a < 2; a++)
+    {
+        for(int i = 0; i < AXIS_PARAMETERS; i++)
+        {
+            int value = profile.axis[a].*axisParameters[i].field;
+            if(axisBindings[i].changed && value != current.axis[a].*axisParameters[i].field)
+                axisBindings[i].changed(a, value);
+        }
+    }
+    ui->statusbar->showMessage("Profile " + name + " applied: " + transaction.stats().text());
+    return true;
+}
+
+void MainWindow::selectAddress(int value)
+{
+    if(value > 0) {
+        TRACED(ahp_gt_copy_device(ahp_gt_get_current_device(), value-1));
+        //the address is not part of the image, always push everything
+        writer.write(nullptr, nullptr, true);
+        writer.forget(value - 1);
+        deviceCache->forget(DeviceCache::deviceKey(ui->ComPort->currentText()), value - 1);
+    }
+    TRACED(ahp_gt_select_device(value));
+}
+
+void MainWindow::addLibraryAction(QMenu *menu, int index)
+{
+    ProfileLibrary::Entry entry = library->entry(index);
+    QAction *action = menu->addAction(entry.name);
+    action->setToolTip("Gearing " + ProfileLibrary::gearing(entry.profile) + ", address " + QString::number(entry.profile.address) +
+                       (entry.firmware >= 0 ? ", firmware " + QString::number(entry.firmware, 16) : "") +
+                       (entry.device.isEmpty() ? "" : ", " + entry.device));
+    connect(action, &QAction::triggered, this, [ = ] ()
+    {
+        applyProfile(entry.profile, entry.name);
+    });
 }
 
 void MainWindow::saveIni(QString ini)
 {
+    TRACE_SCOPE("saveIni");
     QString dir = QDir(ini).dirName();
     if(!QDir(dir).exists())
     {
@@ -333,57 +322,43 @@ void MainWindow::saveIni(QString ini)
         f->close();
         f->~QFile();
     }
-    QSettings *oldsettings = settings;
-    QSettings *s = new QSettings(ini, QSettings::Format::IniFormat);
-    settings = s;
+    //the default profile is kept in memory and written behind, exports go straight to disk
+    SettingsStore *settings = this->settings;
+    if(ini != getDefaultIni())
+        settings = new SettingsStore(ini, 0);
 
-    settings->setValue("Invert_0", ui->Invert_0->isChecked());
-    settings->setValue("SteppingMode_0", ui->SteppingMode_0->currentIndex());
-    settings->setValue("MotorSteps_0", ui->MotorSteps_0->value());
-    settings->setValue("Worm_0", ui->Worm_0->value());
-    settings->setValue("Motor_0", ui->Motor_0->value());
-    settings->setValue("Crown_0", ui->Crown_0->value());
-    settings->setValue("Acceleration_0", ui->Acceleration_0->value());
-    settings->setValue("MaxSpeed_0", ui->MaxSpeed_0->value());
-    settings->setValue("Coil_0", ui->Coil_0->currentIndex());
-    settings->setValue("GPIO_0", ui->GPIO_0->currentIndex());
-    settings->setValue("Inductance_0", ui->Inductance_0->value());
-    settings->setValue("Resistance_0", ui->Resistance_0->value());
-    settings->setValue("Current_0", ui->Current_0->value());
-    settings->setValue("Voltage_0", ui->Voltage_0->value());
-    settings->setValue("Mean_0", ui->Mean_0->value());
-    settings->setValue("Timing_0", ui->Timing_0->value());
-
-    settings->setValue("Invert_1", ui->Invert_1->isChecked());
-    settings->setValue("SteppingMode_1", ui->SteppingMode_1->currentIndex());
-    settings->setValue("MotorSteps_1", ui->MotorSteps_1->value());
-    settings->setValue("Worm_1", ui->Worm_1->value());
-    settings->setValue("Motor_1", ui->Motor_1->value());
-    settings->setValue("Crown_1", ui->Crown_1->value());
-    settings->setValue("Acceleration_1", ui->Acceleration_1->value());
-    settings->setValue("MaxSpeed_1", ui->MaxSpeed_1->value());
-    settings->setValue("Coil_1", ui->Coil_1->currentIndex());
-    settings->setValue("GPIO_1", ui->GPIO_1->currentIndex());
-    settings->setValue("Inductance_1", ui->Inductance_1->value());
-    settings->setValue("Resistance_1", ui->Resistance_1->value());
-    settings->setValue("Current_1", ui->Current_1->value());
-    settings->setValue("Voltage_1", ui->Voltage_1->value());
-    settings->setValue("Mean_1", ui->Mean_1->value());
-    settings->setValue("Timing_1", ui->Timing_1->value());
+    currentProfile().save(settings);
+    if(settings != this->settings)
+    {
+        settings->commit();
+        delete settings;
+    }
+    else
+        settings->scheduleCommit();
+}
 
-    settings->setValue("MountType", ui->MountType->currentIndex());
-    settings->setValue("Address", ui->Address->value());
-    settings->setValue("PWMFreq", ui->PWMFreq->value());
-    settings->setValue("MountStyle", ui->MountStyle->currentIndex());
-    //settings->setValue("HighBauds", ui->HighBauds->isChecked());
-    settings->setValue("Notes", QString(ui->Notes->text().toUtf8().toBase64()));
+Profile MainWindow::currentProfile()
+{
+    Profile profile;
+    for(int a = 0; a < 2; a++)
+    {
+        for(int i = 0; i < AXIS_PARAMETERS; i++)
+            profile.axis[a].*axisParameters[i].field = axisBindings[i].value(a);
+    }
 
-    settings->setValue("Ra", Ra);
-    settings->setValue("Dec", Dec);
-    settings->setValue("Latitude", Latitude);
-    settings->setValue("Longitude", Longitude);
-    s->~QSettings();
-    settings = oldsettings;
+    profile.mount_type = ui->MountType->currentIndex();
+    profile.address = ui->Address->value();
+    profile.pwm_frequency = ui->PWMFreq->value();
+    profile.mount_style = ui->MountStyle->currentIndex();
+    profile.high_bauds = ui->HighBauds->isChecked();
+    profile.half_current = settings->value("HalfCurrent", false).toBool();
+    profile.notes = ui->Notes->text();
+    profile.ra = Ra;
+    profile.dec = Dec;
+    profile.latitude = Latitude;
+    profile.longitude = Longitude;
+    profile.last_port = settings->value("LastPort", "").toString();
+    return profile;
 }
 
 MainWindow::MainWindow(QWidget *parent)
@@ -392,13 +367,14 @@ MainWindow::MainWindow(QWidget *parent)
 {
     ahp_set_app_name("GT Configurator");
     ahp_set_debug_level(AHP_DEBUG_DEBUG);
-    IndicationThread = new Thread(this, 100, 500);
-    ProgressThread = new Thread(this, 100, 10);
-    RaThread = new Thread(this, 500, 1000);
-    DecThread = new Thread(this, 1000, 1000);
-    ServerThread = new Thread(this);
+    scheduler = new Scheduler(this);
+    //jobFinished comes from the pool, queued it lands back on the GUI thread
+    connect(scheduler, &Scheduler::jobFinished, this, [ = ] (int id)
+    {
+        if(id == WriteJob)
+            writeFinished();
+    }, Qt::QueuedConnection);
     setAccessibleName("GT Configurator");
-    firmwareFilename = QStandardPaths::standardLocations(QStandardPaths::TempLocation).at(0) + "/" + strrand(32);
     QString homedir = QStandardPaths::standardLocations(QStandardPaths::AppDataLocation).at(0);
     ini = homedir + "/settings.ini";
     if(!QDir(homedir).exists())
@@ -414,7 +390,19 @@ MainWindow::MainWindow(QWidget *parent)
     }
     stop_correction[0] = true;
     stop_correction[1] = true;
-    settings = new QSettings(ini, QSettings::Format::IniFormat);
+    settings = new SettingsStore(ini, 1000, this);
+    firmwareStore = new FirmwareStore(homedir + "/firmware");
+    deviceCache = new DeviceCache(homedir + "/devices.cache");
+    library = new ProfileLibrary(homedir + "/profiles.library");
+    library->open();
+    //older versions kept the last flashed image in the settings
+    if(settings->contains("firmware"))
+    {
+        firmwareStore->add(QByteArray::fromBase64(settings->value("firmware").toString().toUtf8()), QString(), "settings");
+        settings->remove("firmware");
+        settings->scheduleCommit();
+    }
+    catalog = new FirmwareCatalog(QStandardPaths::standardLocations(QStandardPaths::CacheLocation).at(0) + "/firmware", this);
     isConnected = false;
     this->setFixedSize(1100, 640);
     ui->setupUi(this);
@@ -433,9 +421,28 @@ MainWindow::MainWindow(QWidget *parent)
     }
     else
         ui->ComPort->addItem("No serial ports available");
+    discovery = new PortDiscovery(this);
+    discoverPorts();
     ui->MountType->setCurrentIndex(0);
-    WriteThread = new Thread(this);
-    connect(WriteThread, static_cast<void (Thread::*)(Thread *)>(&Thread::threadLoop), [ = ] (Thread * thread) {
+    connect(settings, &SettingsStore::committed, this, [ = ] ()
+    {
+        SettingsStore::Stats stats = settings->stats();
+        ui->statusbar->showMessage("Settings: " + QString::number(stats.commits) + " writes (" +
+                                   QString::number(stats.bytesWritten) + " bytes), " + QString::number(stats.commitsAvoided) + " avoided (" +
+                                   QString::number(stats.bytesAvoided) + " bytes)");
+    });
+    //tracing can be switched on and off without restarting, see also GT_TRACE
+    QShortcut *traceShortcut = new QShortcut(QKeySequence("Ctrl+Shift+T"), this);
+    connect(traceShortcut, &QShortcut::activated, this, [ = ] ()
+    {
+        if(Trace::toggle(Trace::fileName()))
+            ui->statusbar->showMessage("Tracing started");
+        else
+            ui->statusbar->showMessage("Trace written to " + Trace::fileName());
+    });
+    telemetry.setEstimator(0, (EstimatorType)ui->Estimator_0->currentIndex(), ui->Mean_0->value());
+    telemetry.setEstimator(1, (EstimatorType)ui->Estimator_1->currentIndex(), ui->Mean_1->value());
+    writeJob = [ = ] () {
         saveIni(getDefaultIni());
         percent = 0;
         finished = 0;
@@ -444,147 +451,227 @@ MainWindow::MainWindow(QWidget *parent)
         finished = 0;
         if(ui->Write->text() == "Flash")
         {
-            if(!ahp_gt_is_detected()&&ahp_gt_is_connected()) {
-                ahp_gt_detect_device(&percent);
-                thread->unlock();
-                return;
-            }
-            genFirmware();
-            if(QFile::exists(firmwareFilename)) {
-                while(mutex.tryLock()) QThread::msleep(10);
-                QFile f(firmwareFilename);
-                f.open(QIODevice::ReadOnly);
-                if(!dfu_flash(f.handle(), &percent, &finished))
-                {
-                    settings->setValue("firmware", f.readAll().toBase64());
+            if(!TRACED(ahp_gt_is_detected())&&TRACED(ahp_gt_is_connected())) {
+                TRACED(ahp_gt_detect_device(&percent));
+            } else {
+                genFirmware();
+                if(!firmwareImage.isEmpty()) {
+                    QString port = ui->ComPort->currentText();
+                    QString error;
+                    while(mutex.tryLock()) QThread::msleep(10);
+                    flashBytes = firmwareImage.length();
+                    FlashResult result = flashDevice(port, firmwareImage, forceWrite, &percent, &finished, &error);
+                    flashBytes = 0;
+                    mutex.unlock();
+                    forceWrite = false;
+                    if(result == FlashIdentical) {
+                        //the controller cannot be read back, this is what was recorded here and the version it reports
+                        QMetaObject::invokeMethod(this, [ = ] ()
+                        {
+                            ui->statusbar->showMessage("Flash skipped: " + firmwareProduct + " was last flashed on " + port +
+                                                       " from this computer and the controller still reports the same firmware version"
+                                                       " (shift-click Flash to force it)");
+                        }, Qt::QueuedConnection);
+                    }
                 }
-                f.close();
-                mutex.unlock();
             }
         }
+        else if(busWrite)
+        {
+            BusConfigurator bus(&writer);
+            bus.setRange(0, ui->Address->value(), currentProfile());
+            BusConfigurator::Report report = bus.run(&percent, &finished, forceWrite);
+            //written behind the back of the cache, read back in full on the next connect
+            for(BusConfigurator::DeviceReport device : report.devices)
+                deviceCache->forget(DeviceCache::deviceKey(ui->ComPort->currentText()), device.address);
+            busWrite = false;
+            forceWrite = false;
+            QString text = report.text();
+            QMetaObject::invokeMethod(this, [ = ] ()
+            {
+                ui->statusbar->showMessage("Bus write: " + text.split("\n").last());
+                ui->statusbar->setToolTip(text);
+            }, Qt::QueuedConnection);
+            ui->Write->setEnabled(true);
+            ui->WorkArea->setEnabled(true);
+        }
         else
         {
-            ahp_gt_write_values(0, &percent, &finished);
-            ahp_gt_write_values(1, &percent, &finished);
+            DifferentialWriter::Summary summary = writer.write(&percent, &finished, forceWrite);
+            forceWrite = false;
+            deviceCache->store(DeviceCache::deviceKey(ui->ComPort->currentText()), summary.address, TRACED(ahp_gt_get_mc_version()), DeviceImage::capture());
+            QString message = (summary.forced ? "Full write: " : "Differential write: ") +
+                              QString::number(summary.axesWritten) + " axes written, " + QString::number(summary.axesSkipped) + " skipped in " +
+                              QString::number(summary.elapsed_ms, 'f', 0) + " ms, saved ~" + QString::number(summary.saved_ms, 'f', 0) + " ms (" +
+                              QString::number(summary.bytesSaved) + " bytes)";
+            if(!summary.changed.isEmpty())
+                message += ", changed " + summary.changed.join(" ");
+            QMetaObject::invokeMethod(this, [ = ] ()
+            {
+                ui->statusbar->showMessage(message);
+            }, Qt::QueuedConnection);
             ui->Write->setEnabled(true);
             ui->WorkArea->setEnabled(true);
         }
         ui->Connection->setEnabled(true);
         percent = 0;
-        thread->requestInterruption();
-        thread->unlock();
+    };
+    auto listFirmware = [ = ] (QStringList products)
+    {
+        QStringList shown;
+        for(int i = 0; i < ui->FW_List->count(); i++)
+            shown.append(ui->FW_List->itemText(i));
+        if(products.isEmpty() || products == shown)
+            return;
+        online_resource = true;
+        ui->FW_List->clear();
+        ui->FW_List->addItems(products);
+    };
+    auto selectFirmware = [ = ] ()
+    {
+        QString product = ui->FW_List->currentText();
+        if(product.isEmpty())
+            return;
+        if(catalog->contains(product))
+            ui->Write->setText("Flash");
+        else
+        {
+            //selected again by imageReady once downloaded
+            if(online_resource)
+                catalog->fetch(product);
+            if(bundledFirmware(product).isEmpty())
+                return;
+        }
+        ui->Connection->setEnabled(false);
+        ui->Control->setEnabled(false);
+        ui->commonSettings->setEnabled(false);
+        ui->AdvancedRA->setEnabled(false);
+        ui->AdvancedDec->setEnabled(false);
+    };
+    connect(catalog, &FirmwareCatalog::listChanged, this, listFirmware);
+    connect(catalog, &FirmwareCatalog::imageReady, this, [ = ] (QString product)
+    {
+        if(product == ui->FW_List->currentText() && ui->Write->text() != "Flash")
+            selectFirmware();
     });
-    connect(ServerThread, static_cast<void (Thread::*)(Thread *)>(&Thread::threadLoop), [ = ] (Thread * thread) {
-        ahp_gt_set_aligned(1);
-        threadsStopped = false;
-        ahp_gt_start_synscan_server(11882, &threadsStopped);
-        threadsStopped = true;
-        thread->requestInterruption();
-        thread->unlock();
+    connect(catalog, &FirmwareCatalog::failed, this, [ = ] (QString product, QString error)
+    {
+        ui->statusbar->showMessage((product.isEmpty() ? "Firmware list" : product) + " not updated: " + error);
     });
     connect(ui->LoadFW, static_cast<void (QPushButton::*)(bool)>(&QPushButton::clicked),
             [ = ](bool triggered)
             {
-                QStringList versions = CheckFirmware("https://www.iliaplatone.com/firmware.php?product=gt*", 3000);
-                if(versions.count() > 0) {
-                    ui->FW_List->clear();
-                    for (QString version : versions)
-                        ui->FW_List->addItem(version.replace("firmware/", "").replace("-firmware.bin", ""));
-                }
+                //the cached list is shown at once, the catalog revalidates it in the background
+                listFirmware(catalog->products());
+                catalog->refresh();
             });
     connect(ui->FW_List, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged),
             [ = ](int value)
             {
-                QString url = "https://www.iliaplatone.com/firmware.php?download=yes&product="+ui->FW_List->currentText();
-                if(DownloadFirmware(url, firmwareFilename, settings))
-                    ui->Write->setText("Flash");
-                else {
-                    QFile f(firmwareFilename);
-                    QFile s("qrc:/data/"+ui->FW_List->currentText()+".json");
-                    s.open(QIODevice::ReadOnly);
-                    QJsonDocument doc = QJsonDocument::fromJson(s.readAll());
-                    s.close();
-                    QJsonObject obj = doc.object();
-                    QString base64 = obj["data"].toString();
-                    if(base64.isNull() || base64.isEmpty()) {
-                        f.close();
-                        goto dl_end;
-                    }
-                    f.write(QByteArray::fromBase64(base64.toUtf8()));
-                    f.close();
-                }
-                ui->Connection->setEnabled(false);
-                ui->Control->setEnabled(false);
-                ui->commonSettings->setEnabled(false);
-                ui->AdvancedRA->setEnabled(false);
-                ui->AdvancedDec->setEnabled(false);
-            dl_end:
-                return;
+                selectFirmware();
             });
     connect(ui->Connect, static_cast<void (QPushButton::*)(bool)>(&QPushButton::clicked),
             [ = ](bool checked)
     {
         ui->Connect->setEnabled(false);
+        //a probe may hold the port open
+        discovery->cancel();
+        QElapsedTimer ready;
+        ready.start();
         QString portname;
         int port = 9600;
         QString address = "localhost";
         int failure = 1;
-        ahp_gt_clear();
+        //shift-click reads the whole configuration back regardless
+        bool readBack = (QApplication::keyboardModifiers() & Qt::ShiftModifier) != 0;
+        //runs once the write job has detected the controller
+        auto connected = [ = ] ()
+        {
+            if(TRACED(ahp_gt_is_detected()))
+            {
+                settings->setValue("LastPort", ui->ComPort->currentText());
+                settings->scheduleCommit();
+                ui->Write->setText("Write");
+                ui->Write->setEnabled(true);
+                QString device = DeviceCache::deviceKey(ui->ComPort->currentText());
+                int bus = TRACED(ahp_gt_get_current_device());
+                int version = TRACED(ahp_gt_get_mc_version());
+                DeviceImage cached;
+                bool cache = !readBack && deviceCache->lookup(device, bus, version, &cached);
+                if(cache)
+                    cached.restore();
+                else
+                {
+                    TRACED(ahp_gt_read_values(0));
+                    TRACED(ahp_gt_read_values(1));
+                    deviceCache->store(device, bus, version, DeviceImage::capture());
+                }
+                writer.recordRead();
+                //read before a profile is applied, Profile::apply() clears the high speed flag
+                writer.setBaudRate(DifferentialWriter::linkBaudRate());
+                ui->statusbar->showMessage("Ready in " + QString::number(ready.elapsed()) + " ms" +
+                                           (cache ? ", configuration from the cache (shift-click Connect to read it back)" : ""));
+                FirmwareStore::Device installed = firmwareStore->device(device);
+                if(!installed.hash.isEmpty() && installed.version < 0)
+                {
+                    //first connection after a flash, from now on the version identifies the image
+                    installed.version = TRACED(ahp_gt_get_mc_version());
+                    firmwareStore->setDevice(device, installed);
+                }
+                int flags = TRACED(ahp_gt_get_mount_flags());
+                TRACED(ahp_gt_set_mount_flags((GTFlags)flags));
+                ui->LoadFW->setEnabled(false);
+                ui->Connect->setEnabled(false);
+                ui->Disconnect->setEnabled(true);
+                ui->labelNotes->setEnabled(true);
+                ui->Notes->setEnabled(true);
+                ui->RA->setEnabled(true);
+                ui->DEC->setEnabled(true);
+                ui->Control->setEnabled(true);
+                ui->commonSettings->setEnabled(true);
+                ui->AdvancedRA->setEnabled(true);
+                ui->AdvancedDec->setEnabled(true);
+                ui->loadConfig->setEnabled(true);
+                ui->saveConfig->setEnabled(true);
+                ui->WorkArea->setEnabled(true);
+                oldTracking[0] = false;
+                isTracking[0] = false;
+                isConnected = true;
+                finished = true;
+                ui->ComPort->setEnabled(false);
+                telemetry.reset();
+                scheduler->setEnabled(TelemetryJob, true);
+                //the first tick renders every control
+                viewModel.invalidate();
+                scheduler->setEnabled(IndicationJob, true);
+            }
+            ui->Connect->setEnabled(true);
+        };
+        TRACED(ahp_gt_clear());
         if(ui->ComPort->currentText().contains(':'))
         {
             address = ui->ComPort->currentText().split(":")[0];
             port = ui->ComPort->currentText().split(":")[1].toInt();
-            if(!ahp_gt_connect_udp(address.toStdString().c_str(), port)) {
-                WriteThread->start();
-                WriteThread->block(60000);
-            }
+            if(!TRACED(ahp_gt_connect_udp(address.toStdString().c_str(), port)) && startWrite(connected))
+                return;
         }
         else
         {
             portname.append(ui->ComPort->currentText());
-            if(!ahp_gt_connect(portname.toUtf8())) {
-                WriteThread->start();
-                WriteThread->block(60000);
+            if(!TRACED(ahp_gt_connect(portname.toUtf8()))) {
+                if(startWrite(connected))
+                    return;
             } else {
-                ahp_gt_disconnect();
+                TRACED(ahp_gt_disconnect());
             }
         }
-        if(ahp_gt_is_detected())
-        {
-            settings->setValue("LastPort", ui->ComPort->currentText());
-            ui->Write->setText("Write");
-            ui->Write->setEnabled(true);
-            ahp_gt_read_values(0);
-            ahp_gt_read_values(1);
-            int flags = ahp_gt_get_mount_flags();
-            ahp_gt_set_mount_flags((GTFlags)flags);
-            ui->LoadFW->setEnabled(false);
-            ui->Connect->setEnabled(false);
-            ui->Disconnect->setEnabled(true);
-            ui->labelNotes->setEnabled(true);
-            ui->Notes->setEnabled(true);
-            ui->RA->setEnabled(true);
-            ui->DEC->setEnabled(true);
-            ui->Control->setEnabled(true);
-            ui->commonSettings->setEnabled(true);
-            ui->AdvancedRA->setEnabled(true);
-            ui->AdvancedDec->setEnabled(true);
-            ui->loadConfig->setEnabled(true);
-            ui->saveConfig->setEnabled(true);
-            ui->WorkArea->setEnabled(true);
-            oldTracking[0] = false;
-            isTracking[0] = false;
-            isConnected = true;
-            finished = true;
-            ui->ComPort->setEnabled(false);
-            IndicationThread->start();
-        }
-        ui->Connect->setEnabled(true);
+        connected();
     });
     connect(ui->Disconnect, static_cast<void (QPushButton::*)(bool)>(&QPushButton::clicked),
             [ = ](bool checked)
     {
-        IndicationThread->stop();
+        scheduler->setEnabled(IndicationJob, false);
+        scheduler->setEnabled(TelemetryJob, false);
         ui->Write->setText("Flash");
         ui->Write->setEnabled(true);
         ui->ComPort->setEnabled(true);
@@ -605,25 +692,98 @@ MainWindow::MainWindow(QWidget *parent)
         ui->AdvancedDec->setEnabled(false);
         ui->loadConfig->setEnabled(false);
         ui->saveConfig->setEnabled(false);
-        ahp_gt_stop_motion(0, 0);
-        ahp_gt_stop_motion(1, 0);
-        ahp_gt_disconnect();
-    });
-    connect(ui->loadConfig, static_cast<void (QPushButton::*)(bool)>(&QPushButton::clicked),
-            [ = ](bool triggered)
-    {
-        QString ini = QFileDialog::getOpenFileName(this, "Open configuration file",
-                      QStandardPaths::standardLocations(QStandardPaths::DocumentsLocation).at(0), "Configuration files (*.ini)");
-        if(ini.endsWith(".ini"))
+        TRACED(ahp_gt_stop_motion(0, 0));
+        TRACED(ahp_gt_stop_motion(1, 0));
+        TRACED(ahp_gt_disconnect());
+        discoverPorts();
+    });
+    //the library profiles made for the connected controller are one click away
+    QMenu *loadMenu = new QMenu(this);
+    ui->loadConfig->setMenu(loadMenu);
+    connect(loadMenu, &QMenu::aboutToShow, this, [ = ] ()
+    {
+        loadMenu->clear();
+        QAction *open = loadMenu->addAction("Open file...");
+        QAction *import = loadMenu->addAction("Import directory into the library...");
+        QAction *add = loadMenu->addAction("Add to the library...");
+        connect(open, &QAction::triggered, this, [ = ] ()
         {
-            readIni(ini);
+            QString ini = QFileDialog::getOpenFileName(this, "Open configuration file",
+                          QStandardPaths::standardLocations(QStandardPaths::DocumentsLocation).at(0), "Configuration files (*.ini *" BINARY_PROFILE_SUFFIX ")");
+            if(ini.endsWith(BINARY_PROFILE_SUFFIX))
+            {
+                Profile profile;
+                QString error;
+                if(!BinaryProfile::read(ini, &profile, &error))
+                {
+                    ui->statusbar->showMessage(ini + ": " + error);
+                    return;
+                }
+                //decoded once, applied as it is
+                applyProfile(profile, QFileInfo(ini).completeBaseName());
+            }
+            else if(ini.endsWith(".ini"))
+            {
+                readIni(ini);
+            }
+        });
+        connect(import, &QAction::triggered, this, [ = ] ()
+        {
+            QString dir = QFileDialog::getExistingDirectory(this, "Import configuration files",
+                          QStandardPaths::standardLocations(QStandardPaths::DocumentsLocation).at(0));
+            if(dir.isEmpty())
+                return;
+            QStringList failed;
+            int imported = library->importDirectory(dir, &failed);
+            library->save();
+            ui->statusbar->showMessage(QString::number(imported) + " profiles imported" +
+                                       (failed.isEmpty() ? "" : ", skipped " + failed.join(", ")));
+        });
+        connect(add, &QAction::triggered, this, [ = ] ()
+        {
+            ProfileLibrary::Entry entry;
+            entry.profile = currentProfile();
+            if(isConnected)
+            {
+                entry.device = DeviceCache::deviceKey(ui->ComPort->currentText());
+                entry.firmware = TRACED(ahp_gt_get_mc_version());
+            }
+            entry.name = QInputDialog::getText(this, "Add to the library", "Name:", QLineEdit::Normal,
+                                               ui->MountType->currentText() + " " + QString::number(entry.profile.address));
+            if(entry.name.isEmpty())
+                return;
+            library->add(entry);
+            if(!library->save())
+                ui->statusbar->showMessage("Cannot write " + library->fileName());
+        });
+        QList<int> matches;
+        if(isConnected)
+            matches = library->match(DeviceCache::deviceKey(ui->ComPort->currentText()), TRACED(ahp_gt_get_mc_version()),
+                                     ui->Address->value(), ui->MountType->currentIndex());
+        QMenu *all = (matches.isEmpty() ? loadMenu : new QMenu("All profiles", loadMenu));
+        loadMenu->addSeparator();
+        for(int i : matches)
+            addLibraryAction(loadMenu, i);
+        if(all != loadMenu)
+        {
+            loadMenu->addSeparator();
+            loadMenu->addMenu(all);
         }
+        for(int i = 0; i < library->count(); i++)
+            addLibraryAction(all, i);
     });
     connect(ui->saveConfig, static_cast<void (QPushButton::*)(bool)>(&QPushButton::clicked),
             [ = ](bool triggered)
     {
         QString ini = QFileDialog::getSaveFileName(this, "Save configuration file",
-                      QStandardPaths::standardLocations(QStandardPaths::DocumentsLocation).at(0), "Configuration files (*.ini)");
+                      QStandardPaths::standardLocations(QStandardPaths::DocumentsLocation).at(0),
+                      "Configuration files (*.ini);;Binary profiles (*" BINARY_PROFILE_SUFFIX ")");
+        if(ini.endsWith(BINARY_PROFILE_SUFFIX))
+        {
+            if(!BinaryProfile::write(ini, currentProfile()))
+                ui->statusbar->showMessage("Cannot write " + ini);
+            return;
+        }
         if(!ini.endsWith(".ini"))
             ini = ini.append(".ini");
         saveIni(ini);
@@ -743,204 +903,62 @@ MainWindow::MainWindow(QWidget *parent)
             default:
                 break;
         }*/
-        ahp_gt_set_mount_type(mounttype[index]);
-        saveIni(ini);
-    });
-    connect(ui->Invert_0, static_cast<void (QCheckBox::*)(bool)>(&QCheckBox::clicked),
-            [ = ](bool checked)
-    {
-        ahp_gt_set_direction_invert(0, checked);
-        saveIni(ini);
-    });
-    connect(ui->Invert_1, static_cast<void (QCheckBox::*)(bool)>(&QCheckBox::clicked),
-            [ = ](bool checked)
-    {
-        ahp_gt_set_direction_invert(1, checked);
-        saveIni(ini);
-    });
-    connect(ui->MotorSteps_0, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged),
-            [ = ](int value)
-    {
-        ahp_gt_set_motor_steps(0, value);
-        saveIni(ini);
-    });
-    connect(ui->Worm_0, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged),
-            [ = ](int value)
-    {
-        ahp_gt_set_worm_teeth(0, value);
-        saveIni(ini);
-    });
-    connect(ui->Motor_0, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged),
-            [ = ](int value)
-    {
-        ahp_gt_set_motor_teeth(0, value);
-        saveIni(ini);
-    });
-    connect(ui->Crown_0, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged),
-            [ = ](int value)
-    {
-        ahp_gt_set_crown_teeth(0, value);
-        saveIni(ini);
-    });
-    connect(ui->MotorSteps_1, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged),
-            [ = ](int value)
-    {
-        ahp_gt_set_motor_steps(1, value);
+        TRACED(ahp_gt_set_mount_type(mounttype[index]));
         saveIni(ini);
     });
-    connect(ui->Worm_1, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged),
-            [ = ](int value)
-    {
-        ahp_gt_set_worm_teeth(1, value);
-        saveIni(ini);
-    });
-    connect(ui->Motor_1, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged),
-            [ = ](int value)
-    {
-        ahp_gt_set_motor_teeth(1, value);
-        saveIni(ini);
-    });
-    connect(ui->Crown_1, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged),
-            [ = ](int value)
-    {
-        ahp_gt_set_crown_teeth(1, value);
-        saveIni(ini);
-    });
-    connect(ui->Acceleration_0, static_cast<void (QSlider::*)(int)>(&QSlider::valueChanged),
-            [ = ](int value)
-    {
-        ahp_gt_set_acceleration_angle(0, (ui->Acceleration_0->maximum() - ui->Acceleration_0->value()) * M_PI / 1800.0);
-        ui->Acceleration_label_0->setText("Acceleration: " + QString::number((double)ui->Acceleration_0->maximum() / 10.0 - (double)value / 10.0) + "°");
-        saveIni(ini);
-    });
-    connect(ui->Acceleration_1, static_cast<void (QSlider::*)(int)>(&QSlider::valueChanged),
-            [ = ](int value)
-    {
-        ahp_gt_set_acceleration_angle(1,  (ui->Acceleration_1->maximum() - ui->Acceleration_1->value()) * M_PI / 1800.0);
-        ui->Acceleration_label_1->setText("Acceleration: " + QString::number((double)ui->Acceleration_1->maximum() / 10.0 - (double)value / 10.0) + "°");
-        saveIni(ini);
-    });
-    connect(ui->MaxSpeed_0, static_cast<void (QSlider::*)(int)>(&QSlider::valueChanged),
-            [ = ](int value)
-    {
-        ahp_gt_set_max_speed(0, ui->MaxSpeed_0->value() * M_PI * 2 / SIDEREAL_DAY);
-        saveIni(ini);
-    });
-    connect(ui->MaxSpeed_1, static_cast<void (QSlider::*)(int)>(&QSlider::valueChanged),
-            [ = ](int value)
-    {
-        ahp_gt_set_max_speed(1, ui->MaxSpeed_1->value() * M_PI * 2 / SIDEREAL_DAY);
-        saveIni(ini);
-    });
-    connect(ui->SteppingMode_0, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), [ = ] (int index)
-    {
-        ahp_gt_set_stepping_mode(0, (GTSteppingMode)index);
-        saveIni(ini);
-    });
-    connect(ui->SteppingMode_1, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), [ = ] (int index)
-    {
-        ahp_gt_set_stepping_mode(1, (GTSteppingMode)index);
-        saveIni(ini);
-    });
-    connect(ui->Coil_0, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), [ = ] (int index)
+    bindAxisParameter("Invert", ui->Invert_0, ui->Invert_1);
+    bindAxisParameter("SteppingMode", ui->SteppingMode_0, ui->SteppingMode_1);
+    bindAxisParameter("MotorSteps", ui->MotorSteps_0, ui->MotorSteps_1);
+    bindAxisParameter("Worm", ui->Worm_0, ui->Worm_1);
+    bindAxisParameter("Motor", ui->Motor_0, ui->Motor_1);
+    bindAxisParameter("Crown", ui->Crown_0, ui->Crown_1);
+    bindAxisParameter("Acceleration", ui->Acceleration_0, ui->Acceleration_1, [ = ] (int axis, int value)
     {
-        ahp_gt_set_stepping_conf(0, (GTSteppingConfiguration)index);
-        saveIni(ini);
+        (axis == 0 ? ui->Acceleration_label_0 : ui->Acceleration_label_1)->setText("Acceleration: " + QString::number((double)PROFILE_ACCELERATION_MAX / 10.0 - (double)value / 10.0) + "°");
     });
-    connect(ui->Coil_1, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), [ = ] (int index)
+    bindAxisParameter("MaxSpeed", ui->MaxSpeed_0, ui->MaxSpeed_1);
+    bindAxisParameter("Coil", ui->Coil_0, ui->Coil_1);
+    bindAxisParameter("GPIO", ui->GPIO_0, ui->GPIO_1);
+    bindAxisParameter("Timing", ui->Timing_0, ui->Timing_1, [ = ] (int axis, int)
     {
-        ahp_gt_set_stepping_conf(1, (GTSteppingConfiguration)index);
-        saveIni(ini);
-    });
-    connect(ui->GPIO_0, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), [ = ] (int index)
-    {
-        switch(index)
-        {
-            case 0:
-                ahp_gt_set_feature(0, GpioUnused);
-                break;
-            case 1:
-                ahp_gt_set_feature(0, GpioAsST4);
-                break;
-            case 2:
-                ahp_gt_set_feature(0, GpioAsPulseDrive);
-                break;
-            default:
-                break;
-        }
-        saveIni(ini);
-    });
-    connect(ui->GPIO_1, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), [ = ]  (int index)
-    {
-        switch(index)
-        {
-            case 0:
-                ahp_gt_set_feature(1, GpioUnused);
-                break;
-            case 1:
-                ahp_gt_set_feature(1, GpioAsST4);
-                break;
-            case 2:
-                ahp_gt_set_feature(1, GpioAsPulseDrive);
-                break;
-            default:
-                break;
-        }
-        saveIni(ini);
-    });
-    connect(ui->Timing_0, static_cast<void (QSlider::*)(int)>(&QSlider::valueChanged),
-    [ = ](int value)
-    {
-        ahp_gt_set_timing(0, -value * 1500000.0 / 10000.0 + 1500000.0);
-        saveIni(ini);
-    });
-    connect(ui->Timing_1, static_cast<void (QSlider::*)(int)>(&QSlider::valueChanged),
-    [ = ](int value)
-    {
-        ahp_gt_set_timing(1, -value * 1500000.0 / 10000.0 + 1500000.0);
-        saveIni(ini);
+        writer.invalidate(axis);
     });
     connect(ui->Address, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged),
             [ = ](int value)
     {
-        if(value > 0) {
-            ahp_gt_copy_device(ahp_gt_get_current_device(), value-1);
-            ahp_gt_write_values(0, nullptr, nullptr);
-            ahp_gt_write_values(1, nullptr, nullptr);
-        }
-        ahp_gt_select_device(value);
+        selectAddress(value);
         saveIni(ini);
     });/*
     connect(ui->HighBauds, static_cast<void (QCheckBox::*)(bool)>(&QCheckBox::clicked), [ = ] (bool checked)
     {
-        int flags = (int)ahp_gt_get_mount_flags();
+        int flags = (int)TRACED(ahp_gt_get_mount_flags());
         flags &= ~bauds_115200;
         if(checked)
             flags |= bauds_115200;
-        ahp_gt_set_mount_flags((GTFlags)flags);
+        TRACED(ahp_gt_set_mount_flags((GTFlags)flags));
         saveIni(ini);
     });*/
     connect(ui->PWMFreq, static_cast<void (QSlider::*)(int)>(&QSlider::valueChanged),
     [ = ](int value)
     {
-        ahp_gt_set_pwm_frequency(0, value);
-        ahp_gt_set_pwm_frequency(1, value);
+        TRACED(ahp_gt_set_pwm_frequency(0, value));
+        TRACED(ahp_gt_set_pwm_frequency(1, value));
         ui->PWMFreq_label->setText("PWM: " + QString::number(366 + 366 * value) + " Hz");
         saveIni(ini);
     });
     connect(ui->MountStyle, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged),
     [ = ](int index)
     {
-        int flags = (int)ahp_gt_get_mount_flags();
+        int flags = (int)TRACED(ahp_gt_get_mount_flags());
         if(index == 2) {
-            ahp_gt_set_features(0, (SkywatcherFeature)(ahp_gt_get_features(0) | isAZEQ));
-            ahp_gt_set_features(1, (SkywatcherFeature)(ahp_gt_get_features(1) | isAZEQ));
+            TRACED(ahp_gt_set_features(0, (SkywatcherFeature)(ahp_gt_get_features(0) | isAZEQ)));
+            TRACED(ahp_gt_set_features(1, (SkywatcherFeature)(ahp_gt_get_features(1) | isAZEQ)));
         } else {
-            ahp_gt_set_features(0, (SkywatcherFeature)(ahp_gt_get_features(0) & ~isAZEQ));
-            ahp_gt_set_features(1, (SkywatcherFeature)(ahp_gt_get_features(1) & ~isAZEQ));
+            TRACED(ahp_gt_set_features(0, (SkywatcherFeature)(ahp_gt_get_features(0) & ~isAZEQ)));
+            TRACED(ahp_gt_set_features(1, (SkywatcherFeature)(ahp_gt_get_features(1) & ~isAZEQ)));
         }
         flags &= ~isForkMount;
-        ahp_gt_set_mount_flags((GTFlags)(flags | (index == 1 ? isForkMount : 0)));
+        TRACED(ahp_gt_set_mount_flags((GTFlags)(flags | (index == 1 ? isForkMount : 0))));
         saveIni(ini);
     });
     connect(ui->Ra_Speed, static_cast<void (QSlider::*)(int)>(&QSlider::valueChanged),
@@ -957,8 +975,8 @@ MainWindow::MainWindow(QWidget *parent)
             [ = ]()
     {
         isTracking[0] = false;
-        ahp_gt_stop_motion(0, axisdirection[0] != true || axis_lospeed[0] != (fabs(ui->Ra_Speed->value()) < 128.0));
-        ahp_gt_start_motion(0, ui->Ra_Speed->value() * M_PI * 2 / SIDEREAL_DAY);
+        TRACED(ahp_gt_stop_motion(0, axisdirection[0] != true || axis_lospeed[0] != (fabs(ui->Ra_Speed->value()) < 128.0)));
+        TRACED(ahp_gt_start_motion(0, ui->Ra_Speed->value() * M_PI * 2 / SIDEREAL_DAY));
         axisdirection[0] = true;
         axis_lospeed[0] = (fabs(ui->Ra_Speed->value()) < 128.0);
     });
@@ -966,8 +984,8 @@ MainWindow::MainWindow(QWidget *parent)
             [ = ]()
     {
         isTracking[0] = false;
-        ahp_gt_stop_motion(0, axisdirection[0] != false || axis_lospeed[0] != (fabs(ui->Ra_Speed->value()) < 128.0));
-        ahp_gt_start_motion(0, -ui->Ra_Speed->value() * M_PI * 2 / SIDEREAL_DAY);
+        TRACED(ahp_gt_stop_motion(0, axisdirection[0] != false || axis_lospeed[0] != (fabs(ui->Ra_Speed->value()) < 128.0)));
+        TRACED(ahp_gt_start_motion(0, -ui->Ra_Speed->value() * M_PI * 2 / SIDEREAL_DAY));
         axisdirection[0] = false;
         axis_lospeed[0] = (fabs(ui->Ra_Speed->value()) < 128.0);
     });
@@ -975,8 +993,8 @@ MainWindow::MainWindow(QWidget *parent)
             [ = ]()
     {
         isTracking[1] = false;
-        ahp_gt_stop_motion(1, axisdirection[1] != true || axis_lospeed[1] != (fabs(ui->Dec_Speed->value()) < 128.0));
-        ahp_gt_start_motion(1, ui->Dec_Speed->value() * M_PI * 2 / SIDEREAL_DAY);
+        TRACED(ahp_gt_stop_motion(1, axisdirection[1] != true || axis_lospeed[1] != (fabs(ui->Dec_Speed->value()) < 128.0)));
+        TRACED(ahp_gt_start_motion(1, ui->Dec_Speed->value() * M_PI * 2 / SIDEREAL_DAY));
         axisdirection[1] = true;
         axis_lospeed[1] = (fabs(ui->Dec_Speed->value()) < 128.0);
     });
@@ -984,8 +1002,8 @@ MainWindow::MainWindow(QWidget *parent)
             [ = ]()
     {
         isTracking[1] = false;
-        ahp_gt_stop_motion(1, axisdirection[1] != false || axis_lospeed[1] != (fabs(ui->Dec_Speed->value()) < 128.0));
-        ahp_gt_start_motion(1, -ui->Dec_Speed->value() * M_PI * 2 / SIDEREAL_DAY);
+        TRACED(ahp_gt_stop_motion(1, axisdirection[1] != false || axis_lospeed[1] != (fabs(ui->Dec_Speed->value()) < 128.0)));
+        TRACED(ahp_gt_start_motion(1, -ui->Dec_Speed->value() * M_PI * 2 / SIDEREAL_DAY));
         axisdirection[1] = false;
         axis_lospeed[1] = (fabs(ui->Dec_Speed->value()) < 128.0);
     });
@@ -994,10 +1012,10 @@ MainWindow::MainWindow(QWidget *parent)
     {
         isTracking[0] = false;
         isTracking[1] = false;
-        ahp_gt_stop_motion(0, axisdirection[0] != true || axis_lospeed[0] != (fabs(ui->Ra_Speed->value()) < 128.0));
-        ahp_gt_start_motion(0, ui->Ra_Speed->value() * M_PI * 2 / SIDEREAL_DAY);
-        ahp_gt_stop_motion(1, axisdirection[1] != true || axis_lospeed[1] != (fabs(ui->Dec_Speed->value()) < 128.0));
-        ahp_gt_start_motion(1, ui->Dec_Speed->value() * M_PI * 2 / SIDEREAL_DAY);
+        TRACED(ahp_gt_stop_motion(0, axisdirection[0] != true || axis_lospeed[0] != (fabs(ui->Ra_Speed->value()) < 128.0)));
+        TRACED(ahp_gt_start_motion(0, ui->Ra_Speed->value() * M_PI * 2 / SIDEREAL_DAY));
+        TRACED(ahp_gt_stop_motion(1, axisdirection[1] != true || axis_lospeed[1] != (fabs(ui->Dec_Speed->value()) < 128.0)));
+        TRACED(ahp_gt_start_motion(1, ui->Dec_Speed->value() * M_PI * 2 / SIDEREAL_DAY));
         axisdirection[0] = true;
         axis_lospeed[0] = (fabs(ui->Ra_Speed->value()) < 128.0);
         axisdirection[1] = true;
@@ -1008,10 +1026,10 @@ MainWindow::MainWindow(QWidget *parent)
     {
         isTracking[0] = false;
         isTracking[1] = false;
-        ahp_gt_stop_motion(0, axisdirection[0] != false || axis_lospeed[0] != (fabs(ui->Ra_Speed->value()) < 128.0));
-        ahp_gt_start_motion(0, -ui->Ra_Speed->value() * M_PI * 2 / SIDEREAL_DAY);
-        ahp_gt_stop_motion(1, axisdirection[1] != true || axis_lospeed[1] != (fabs(ui->Dec_Speed->value()) < 128.0));
-        ahp_gt_start_motion(1, ui->Dec_Speed->value() * M_PI * 2 / SIDEREAL_DAY);
+        TRACED(ahp_gt_stop_motion(0, axisdirection[0] != false || axis_lospeed[0] != (fabs(ui->Ra_Speed->value()) < 128.0)));
+        TRACED(ahp_gt_start_motion(0, -ui->Ra_Speed->value() * M_PI * 2 / SIDEREAL_DAY));
+        TRACED(ahp_gt_stop_motion(1, axisdirection[1] != true || axis_lospeed[1] != (fabs(ui->Dec_Speed->value()) < 128.0)));
+        TRACED(ahp_gt_start_motion(1, ui->Dec_Speed->value() * M_PI * 2 / SIDEREAL_DAY));
         axisdirection[0] = false;
         axis_lospeed[0] = (fabs(ui->Ra_Speed->value()) < 128.0);
         axisdirection[1] = true;
@@ -1022,10 +1040,10 @@ MainWindow::MainWindow(QWidget *parent)
     {
         isTracking[0] = false;
         isTracking[1] = false;
-        ahp_gt_stop_motion(0, axisdirection[0] != true || axis_lospeed[0] != (fabs(ui->Ra_Speed->value()) < 128.0));
-        ahp_gt_start_motion(0, ui->Ra_Speed->value() * M_PI * 2 / SIDEREAL_DAY);
-        ahp_gt_stop_motion(1, axisdirection[1] != false || axis_lospeed[1] != (fabs(ui->Dec_Speed->value()) < 128.0));
-        ahp_gt_start_motion(1, -ui->Dec_Speed->value() * M_PI * 2 / SIDEREAL_DAY);
+        TRACED(ahp_gt_stop_motion(0, axisdirection[0] != true || axis_lospeed[0] != (fabs(ui->Ra_Speed->value()) < 128.0)));
+        TRACED(ahp_gt_start_motion(0, ui->Ra_Speed->value() * M_PI * 2 / SIDEREAL_DAY));
+        TRACED(ahp_gt_stop_motion(1, axisdirection[1] != false || axis_lospeed[1] != (fabs(ui->Dec_Speed->value()) < 128.0)));
+        TRACED(ahp_gt_start_motion(1, -ui->Dec_Speed->value() * M_PI * 2 / SIDEREAL_DAY));
         axisdirection[0] = true;
         axis_lospeed[0] = (fabs(ui->Ra_Speed->value()) < 128.0);
         axisdirection[1] = false;
@@ -1036,10 +1054,10 @@ MainWindow::MainWindow(QWidget *parent)
     {
         isTracking[0] = false;
         isTracking[1] = false;
-        ahp_gt_stop_motion(0, axisdirection[0] != false || axis_lospeed[0] != (fabs(ui->Ra_Speed->value()) < 128.0));
-        ahp_gt_start_motion(0, -ui->Ra_Speed->value() * M_PI * 2 / SIDEREAL_DAY);
-        ahp_gt_stop_motion(1, axisdirection[1] != false || axis_lospeed[1] != (fabs(ui->Dec_Speed->value()) < 128.0));
-        ahp_gt_start_motion(1, -ui->Dec_Speed->value() * M_PI * 2 / SIDEREAL_DAY);
+        TRACED(ahp_gt_stop_motion(0, axisdirection[0] != false || axis_lospeed[0] != (fabs(ui->Ra_Speed->value()) < 128.0)));
+        TRACED(ahp_gt_start_motion(0, -ui->Ra_Speed->value() * M_PI * 2 / SIDEREAL_DAY));
+        TRACED(ahp_gt_stop_motion(1, axisdirection[1] != false || axis_lospeed[1] != (fabs(ui->Dec_Speed->value()) < 128.0)));
+        TRACED(ahp_gt_start_motion(1, -ui->Dec_Speed->value() * M_PI * 2 / SIDEREAL_DAY));
         axisdirection[0] = false;
         axis_lospeed[0] = (fabs(ui->Ra_Speed->value()) < 128.0);
         axisdirection[1] = false;
@@ -1050,52 +1068,52 @@ MainWindow::MainWindow(QWidget *parent)
     {
         oldTracking[0] = false;
         oldTracking[1] = false;
-        ahp_gt_stop_motion(0, 0);
-        ahp_gt_stop_motion(1, 0);
+        TRACED(ahp_gt_stop_motion(0, 0));
+        TRACED(ahp_gt_stop_motion(1, 0));
     });
     connect(ui->W, static_cast<void (QPushButton::*)()>(&QPushButton::released),
             [ = ]()
     {
-        ahp_gt_stop_motion(0, 0);
+        TRACED(ahp_gt_stop_motion(0, 0));
     });
     connect(ui->E, static_cast<void (QPushButton::*)()>(&QPushButton::released),
             [ = ]()
     {
-        ahp_gt_stop_motion(0, 0);
+        TRACED(ahp_gt_stop_motion(0, 0));
     });
     connect(ui->N, static_cast<void (QPushButton::*)()>(&QPushButton::released),
             [ = ]()
     {
-        ahp_gt_stop_motion(1, 0);
+        TRACED(ahp_gt_stop_motion(1, 0));
     });
     connect(ui->S, static_cast<void (QPushButton::*)()>(&QPushButton::released),
             [ = ]()
     {
-        ahp_gt_stop_motion(1, 0);
+        TRACED(ahp_gt_stop_motion(1, 0));
     });
     connect(ui->NW, static_cast<void (QPushButton::*)()>(&QPushButton::released),
             [ = ]()
     {
-        ahp_gt_stop_motion(0, 0);
-        ahp_gt_stop_motion(1, 0);
+        TRACED(ahp_gt_stop_motion(0, 0));
+        TRACED(ahp_gt_stop_motion(1, 0));
     });
     connect(ui->NE, static_cast<void (QPushButton::*)()>(&QPushButton::released),
             [ = ]()
     {
-        ahp_gt_stop_motion(0, 0);
-        ahp_gt_stop_motion(1, 0);
+        TRACED(ahp_gt_stop_motion(0, 0));
+        TRACED(ahp_gt_stop_motion(1, 0));
     });
     connect(ui->SW, static_cast<void (QPushButton::*)()>(&QPushButton::released),
             [ = ]()
     {
-        ahp_gt_stop_motion(0, 0);
-        ahp_gt_stop_motion(1, 0);
+        TRACED(ahp_gt_stop_motion(0, 0));
+        TRACED(ahp_gt_stop_motion(1, 0));
     });
     connect(ui->SE, static_cast<void (QPushButton::*)()>(&QPushButton::released),
             [ = ]()
     {
-        ahp_gt_stop_motion(0, 0);
-        ahp_gt_stop_motion(1, 0);
+        TRACED(ahp_gt_stop_motion(0, 0));
+        TRACED(ahp_gt_stop_motion(1, 0));
     });
     connect(ui->Tracking, static_cast<void (QCheckBox::*)(bool)>(&QCheckBox::clicked),
             [ = ](bool checked)
@@ -1161,53 +1179,25 @@ MainWindow::MainWindow(QWidget *parent)
     {
         oldTracking[0] = false;
         oldTracking[1] = false;
-        if(ui->Write->text() == "Write")
-        {
-        }
+        //shift-click falls back to a full write of both axes, or flashes identical firmware too
+        forceWrite = (QApplication::keyboardModifiers() & Qt::ShiftModifier) != 0;
+        //ctrl-click writes the profile to the addresses from 0 to the selected one
+        busWrite = ui->Write->text() == "Write" && (QApplication::keyboardModifiers() & Qt::ControlModifier);
 
-        WriteThread->start();
-        WriteThread->block(60000);
-    });
-    connect(ui->Inductance_0, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged),
-            [ = ](int value)
-    {
-        saveIni(ini);
-    });
-    connect(ui->Resistance_0, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged),
-            [ = ](int value)
-    {
-        saveIni(ini);
-    });
-    connect(ui->Current_0, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged),
-            [ = ](int value)
-    {
-        saveIni(ini);
-    });
-    connect(ui->Voltage_0, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged),
-            [ = ](int value)
-    {
-        saveIni(ini);
-    });
-    connect(ui->Inductance_1, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged),
-            [ = ](int value)
-    {
-        saveIni(ini);
+        startWrite();
     });
-    connect(ui->Resistance_1, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged),
-            [ = ](int value)
+    bindAxisParameter("Mean", ui->Mean_0, ui->Mean_1, [ = ] (int axis, int value)
     {
-        saveIni(ini);
+        telemetry.setEstimator(axis, (EstimatorType)(axis == 0 ? ui->Estimator_0 : ui->Estimator_1)->currentIndex(), value);
     });
-    connect(ui->Current_1, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged),
-            [ = ](int value)
+    bindAxisParameter("Estimator", ui->Estimator_0, ui->Estimator_1, [ = ] (int axis, int value)
     {
-        saveIni(ini);
-    });
-    connect(ui->Voltage_1, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged),
-            [ = ](int value)
-    {
-        saveIni(ini);
+        telemetry.setEstimator(axis, (EstimatorType)value, (axis == 0 ? ui->Mean_0 : ui->Mean_1)->value());
     });
+    bindAxisParameter("Inductance", ui->Inductance_0, ui->Inductance_1);
+    bindAxisParameter("Resistance", ui->Resistance_0, ui->Resistance_1);
+    bindAxisParameter("Current", ui->Current_0, ui->Current_1);
+    bindAxisParameter("Voltage", ui->Voltage_0, ui->Voltage_1);
     connect(ui->Ra_0, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), [ = ](int value)
     {
         if(value < 0)
@@ -1324,183 +1314,156 @@ MainWindow::MainWindow(QWidget *parent)
     {
         isTracking[0] = false;
         isTracking[1] = false;
-        ahp_gt_set_location(Latitude, Longitude, 0);
-        ahp_gt_goto_radec(Ra, Dec);
+        TRACED(ahp_gt_set_location(Latitude, Longitude, 0));
+        TRACED(ahp_gt_goto_radec(Ra, Dec));
     });
     connect(ui->Halt, static_cast<void (QPushButton::*)(bool)>(&QPushButton::clicked), [ = ](bool checked)
     {
-        ahp_gt_stop_motion(0, 0);
-        ahp_gt_stop_motion(1, 0);
+        TRACED(ahp_gt_stop_motion(0, 0));
+        TRACED(ahp_gt_stop_motion(1, 0));
     });
     connect(ui->Server, static_cast<void (QCheckBox::*)(bool)>(&QCheckBox::clicked), [ = ] (bool checked)
     {
         oldTracking[0] = false;
         oldTracking[1] = false;
-        if(checked) {
+        if(checked && !scheduler->isPending(ServerJob)) {
             threadsStopped = false;
-            ServerThread->start();
+            ServerJob = scheduler->runBlocking("Server", [ = ] () {
+                TRACED(ahp_gt_set_aligned(1));
+                threadsStopped = false;
+                TRACED(ahp_gt_start_synscan_server(11882, &threadsStopped));
+                threadsStopped = true;
+            });
         }
         if(!threadsStopped && !checked) {
             threadsStopped = true;
         }
     });
-    connect(ProgressThread, static_cast<void (Thread::*)(Thread *)>(&Thread::threadLoop), this, [ = ] (Thread * parent)
+    ProgressJob = scheduler->addPeriodic("Progress", 10, [ = ] ()
     {
         ui->progress->setValue(fmax(ui->progress->minimum(), fmin(ui->progress->maximum(), percent)));
-        parent->unlock();
-    });
-    connect(IndicationThread, static_cast<void (Thread::*)(Thread *)>(&Thread::threadLoop), this, [ = ] (Thread * parent)
+        qint64 total = flashBytes;
+        if(total > 0)
+        {
+            //dfu_flash reports a percentage only, the bytes are derived from it
+            qint64 bytes = total * fmax(0, fmin(100, percent)) / 100;
+            ui->progress->setFormat("%p% - ~" + QString::number(bytes) + "/" + QString::number(total) + " bytes");
+        }
+    }, this, false);
+    IndicationJob = scheduler->addPeriodic("Indication", 500, [ = ] ()
     {
         if(isConnected && finished)
         {
+            TelemetrySnapshot snapshot = telemetry.snapshot();
             for(int a = 0; a < 2; a++)
             {
                 if(a == 0)
                 {
-                    ui->CurrentSteps_0->setText(QString::number((int)currentSteps[a]));
-                    ui->Rate_0->setText("deg/sec: " + QString::number(Speed[a]));
+                    ui->CurrentSteps_0->setText(QString::number((int)snapshot.axis[a].steps));
+                    ui->Rate_0->setText("deg/sec: " + QString::number(snapshot.axis[a].speed) + " ±" + QString::number(sqrt(snapshot.axis[a].speed_variance), 'g', 2));
                 }
                 if(a == 1)
                 {
-                    ui->CurrentSteps_1->setText(QString::number(currentSteps[a]));
-                    ui->Rate_1->setText("deg/sec: " + QString::number(Speed[a]));
+                    ui->CurrentSteps_1->setText(QString::number(snapshot.axis[a].steps));
+                    ui->Rate_1->setText("deg/sec: " + QString::number(snapshot.axis[a].speed) + " ±" + QString::number(sqrt(snapshot.axis[a].speed_variance), 'g', 2));
                 }
                 UpdateValues(a);
             }
+            UpdateMount();
         }
-
-        parent->unlock();
-    });
-    connect(RaThread, static_cast<void (Thread::*)(Thread *)>(&Thread::threadLoop), [ = ] (Thread * parent)
+    }, this, false);
+    TelemetryJob = scheduler->addPeriodic("Telemetry", 1000, [ = ] ()
     {
-        int a = 0;
+        //sampled on the scheduler pool, the window reacts on the GUI thread
         if(isConnected && finished)
         {
-            currentSteps[a] = ahp_gt_get_position(a, &status[a].timestamp) * ahp_gt_get_totalsteps(a) / M_PI / 2.0;
-            if(oldTracking[a] && !isTracking[a]) {
-                status[a] = ahp_gt_get_status(a);
-                if(status[a].Running == 0) {
-                    ahp_gt_start_tracking(a);
-                    axis_lospeed[a] = true;
-                    isTracking[a] = true;
-                }
-            }
-            if(!oldTracking[a] && isTracking[a]) {
-                ahp_gt_stop_motion(a, 0);
-                isTracking[a] = false;
-            }
-            double diffTime = (double)status[a].timestamp-lastPollTime[a];
-            lastPollTime[a] = status[a].timestamp;
-            double speed;
-            double diffSteps = currentSteps[a] - lastSteps[a];
-            lastSteps[a] = currentSteps[a];
-            diffSteps *= 360.0 / ahp_gt_get_totalsteps(a);
-            speed = 0.0;
-            int _n_speeds = 1;
-            if(a == 0)
-                _n_speeds = ui->Mean_0->value();
-            else
-                _n_speeds = ui->Mean_1->value();
-            for(int s = 0; s < _n_speeds; s++)
+            telemetry.sample();
+            TelemetrySnapshot snapshot = telemetry.snapshot();
+            QMetaObject::invokeMethod(this, [ = ] ()
             {
-                if(s < _n_speeds - 1)
-                    lastSpeeds[a][s] = lastSpeeds[a][s + 1];
-                else
-                    lastSpeeds[a][s] = diffSteps;
-                speed += lastSpeeds[a][s];
-            }
-            speed /= _n_speeds * diffTime;
-            Speed[a] = speed;
-            if(!stop_correction[a]) {
-                bool oldtracking = oldTracking[a];
-                oldTracking[a] = false;
-                isTracking[a] = false;
-                ahp_gt_correct_tracking(a, SIDEREAL_DAY * ahp_gt_get_wormsteps(a) / ahp_gt_get_totalsteps(a), &stop_correction[a]);
-                if(a == 0) {
-                    if(ui->TuneRa->isChecked())
-                        ui->TuneRa->click();
-                } else {
-                    if(ui->TuneDec->isChecked())
-                        ui->TuneDec->click();
-                }
-                oldTracking[a] = oldtracking;
-            }
+                updateTracking(snapshot);
+            }, Qt::QueuedConnection);
         }
-        parent->unlock();
-    });
-    connect(DecThread, static_cast<void (Thread::*)(Thread *)>(&Thread::threadLoop), [ = ] (Thread * parent)
-    {
-        int a = 1;
-        if(isConnected && finished)
-        {
-            currentSteps[a] = ahp_gt_get_position(a, &status[a].timestamp) * ahp_gt_get_totalsteps(a) / M_PI / 2.0;
-            if(oldTracking[a] && !isTracking[a]) {
-                status[a] = ahp_gt_get_status(a);
-                if(status[a].Running == 0) {
-                    ahp_gt_start_tracking(a);
-                    axis_lospeed[a] = true;
-                    isTracking[a] = true;
-                }
-            }
-            if(!oldTracking[a] && isTracking[a]) {
-                ahp_gt_stop_motion(a, 0);
-                isTracking[a] = false;
+    }, nullptr, false);
+}
+
+void MainWindow::updateTracking(TelemetrySnapshot snapshot)
+{
+    if(!isConnected)
+        return;
+    for(int a = 0; a < 2; a++)
+    {
+        bool start = false;
+        bool stop = false;
+        if(oldTracking[a] && !isTracking[a]) {
+            if(snapshot.axis[a].status.Running == 0) {
+                start = true;
+                axis_lospeed[a] = true;
+                isTracking[a] = true;
             }
-            double diffTime = (double)status[a].timestamp-lastPollTime[a];
-            lastPollTime[a] = status[a].timestamp;
-            double diffSteps = currentSteps[a] - lastSteps[a];
-            lastSteps[a] = currentSteps[a];
-            diffSteps *= 360.0 / ahp_gt_get_totalsteps(a);
-            Speed[a] = 0.0;
-            int _n_speeds = 1;
-            if(a == 0)
-                _n_speeds = ui->Mean_0->value();
-            else
-                _n_speeds = ui->Mean_1->value();
-            for(int s = 0; s < _n_speeds; s++)
-            {
-                if(s < _n_speeds - 1)
-                    lastSpeeds[a][s] = lastSpeeds[a][s + 1];
+        }
+        if(!oldTracking[a] && isTracking[a]) {
+            stop = true;
+            isTracking[a] = false;
+        }
+        if(start || stop) {
+            scheduler->runBlocking("Tracking", [ = ] () {
+                if(start)
+                    TRACED(ahp_gt_start_tracking(a));
                 else
-                    lastSpeeds[a][s] = diffSteps;
-                Speed[a] += lastSpeeds[a][s];
-            }
-            Speed[a] /= _n_speeds * diffTime;
-            if(!stop_correction[a]) {
-                bool oldtracking = oldTracking[a];
-                oldTracking[a] = false;
-                isTracking[a] = false;
-                ahp_gt_correct_tracking(a, SIDEREAL_DAY * ahp_gt_get_wormsteps(a) / ahp_gt_get_totalsteps(a), &stop_correction[a]);
-                if(a == 0) {
-                    if(ui->TuneRa->isChecked())
-                        ui->TuneRa->click();
-                } else {
-                    if(ui->TuneDec->isChecked())
-                        ui->TuneDec->click();
-                }
-                oldTracking[a] = oldtracking;
-            }
+                    TRACED(ahp_gt_stop_motion(a, 0));
+            });
         }
-        parent->unlock();
-    });
-    RaThread->start();
-    DecThread->start();
-    ProgressThread->start();
+        if(!stop_correction[a] && !scheduler->isPending(CorrectionJob[a])) {
+            bool oldtracking = oldTracking[a];
+            oldTracking[a] = false;
+            isTracking[a] = false;
+            CorrectionJob[a] = scheduler->runBlocking("Correction", [ = ] () {
+                TRACED(ahp_gt_correct_tracking(a, SIDEREAL_DAY * ahp_gt_get_wormsteps(a) / ahp_gt_get_totalsteps(a), &stop_correction[a]));
+                QMetaObject::invokeMethod(this, [ = ] () {
+                    if(a == 0) {
+                        if(ui->TuneRa->isChecked())
+                            ui->TuneRa->click();
+                    } else {
+                        if(ui->TuneDec->isChecked())
+                            ui->TuneDec->click();
+                    }
+                    oldTracking[a] = oldtracking;
+                }, Qt::QueuedConnection);
+            });
+        }
+    }
+}
+
+bool MainWindow::startWrite(std::function<void()> done)
+{
+    if(scheduler->isPending(WriteJob))
+        return false;
+    scheduler->setEnabled(ProgressJob, true);
+    writeDone = done;
+    WriteJob = scheduler->runBlocking("Write", writeJob);
+    return true;
+}
+
+void MainWindow::writeFinished()
+{
+    scheduler->setEnabled(ProgressJob, false);
+    ui->progress->setValue(fmax(ui->progress->minimum(), fmin(ui->progress->maximum(), percent)));
+    ui->progress->setFormat("%p%");
+    std::function<void()> done = writeDone;
+    writeDone = nullptr;
+    if(done)
+        done();
 }
 
 MainWindow::~MainWindow()
 {
     if(isConnected)
         ui->Disconnect->click();
-    RaThread->stop();
-    DecThread->stop();
-    IndicationThread->stop();
-    ProgressThread->stop();
-    WriteThread->stop();
-    ServerThread->stop();
-    if(QFile(firmwareFilename).exists())
-        unlink(firmwareFilename.toUtf8());
     threadsStopped = true;
+    scheduler->stop();
+    delete firmwareStore;
+    delete deviceCache;
     delete ui;
 }
 
@@ -1511,188 +1474,110 @@ void MainWindow::disconnectControls(bool block)
     ui->MountStyle->blockSignals(block);
     ui->PWMFreq->blockSignals(block);
 
-    ui->Invert_0->blockSignals(block);
-    ui->MotorSteps_0->blockSignals(block);
-    ui->Worm_0->blockSignals(block);
-    ui->Motor_0->blockSignals(block);
-    ui->Crown_0->blockSignals(block);
-    ui->Acceleration_0->blockSignals(block);
-    ui->MaxSpeed_0->blockSignals(block);
-    ui->SteppingMode_0->blockSignals(block);
-    ui->Coil_0->blockSignals(block);
-    ui->GPIO_0->blockSignals(block);
-
-    ui->Invert_1->blockSignals(block);
-    ui->MotorSteps_1->blockSignals(block);
-    ui->Worm_1->blockSignals(block);
-    ui->Motor_1->blockSignals(block);
-    ui->Crown_1->blockSignals(block);
-    ui->Acceleration_1->blockSignals(block);
-    ui->MaxSpeed_1->blockSignals(block);
-    ui->SteppingMode_1->blockSignals(block);
-    ui->Coil_1->blockSignals(block);
-    ui->GPIO_1->blockSignals(block);
+    for(int i = 0; i < AXIS_PARAMETERS; i++)
+    {
+        axisBindings[i].widget[0]->blockSignals(block);
+        axisBindings[i].widget[1]->blockSignals(block);
+    }
 }
 
 void MainWindow::UpdateValues(int axis)
 {
-    disconnectControls(true);
+    TRACE_SCOPE("UpdateValues");
+    AxisView view = AxisView::fromLibrary(axis);
     if(axis == 0)
+        view.motor_pwm = motorPwmFrequency(ui->Inductance_0->value(), ui->Resistance_0->value(), ui->Current_0->value(), ui->Voltage_0->value());
+    else
+        view.motor_pwm = motorPwmFrequency(ui->Inductance_1->value(), ui->Resistance_1->value(), ui->Current_1->value(), ui->Voltage_1->value());
+    view.timing = (axis == 0 ? ui->Timing_0 : ui->Timing_1)->value();
+    int changed = viewModel.update(axis, view);
+    //idle ticks end here
+    if(!changed)
+        return;
+    disconnectControls(true);
+    if(changed & ViewModel::GearingField)
     {
-        double totalsteps = ahp_gt_get_totalsteps(0) * ahp_gt_get_divider(0) / ahp_gt_get_multiplier(0);
-        ui->Divider0->setText(QString::number(ahp_gt_get_divider(0)));
-        ui->Multiplier0->setText(QString::number(ahp_gt_get_multiplier(0)));
-        ui->WormSteps0->setText(QString::number(ahp_gt_get_wormsteps(0)));
-        ui->TotalSteps0->setText(QString::number(ahp_gt_get_totalsteps(0)));
-        ui->TrackingFrequency_0->setText("Steps/s: " + QString::number(totalsteps / SIDEREAL_DAY));
-        ui->SPT_0->setText("sec/turn: " + QString::number(SIDEREAL_DAY / (ahp_gt_get_crown_teeth(0)*ahp_gt_get_worm_teeth(
-                               0) / ahp_gt_get_motor_teeth(0))));
-        double L = (double)ui->Inductance_0->value() / 1000000.0;
-        double R = (double)ui->Resistance_0->value() / 1000.0;
-        double mI = (double)ui->Current_0->value() / 1000.0;
-        double mV = (double)ui->Voltage_0->value();
-        double Z = sqrt(fmax(0, pow(mV / mI, 2.0) - pow(R, 2.0)));
-        double f = (2.0 * M_PI * Z / L);
-        ui->PWMFrequency_0->setText("PWM Hz: " + QString::number(f));
-        ui->GotoFrequency_0->setText("Goto Hz: " + QString::number(totalsteps * ahp_gt_get_max_speed(0) / M_PI / 2));
-        ui->MotorSteps_0->setValue(ahp_gt_get_motor_steps(0));
-        ui->Motor_0->setValue(ahp_gt_get_motor_teeth(0));
-        ui->Worm_0->setValue(ahp_gt_get_worm_teeth(0));
-        ui->Crown_0->setValue(ahp_gt_get_crown_teeth(0));
-        ui->Acceleration_0->setValue(ui->Acceleration_0->maximum() - ahp_gt_get_acceleration_angle(0) * 1800.0 / M_PI);
-        ui->MaxSpeed_0->setMaximum(2000);
-        ui->Ra_Speed->setMaximum(2000);
-        ui->MaxSpeed_0->setValue(ahp_gt_get_max_speed(0) * SIDEREAL_DAY / M_PI / 2);
-        ui->MaxSpeed_label_0->setText("Maximum speed: " + QString::number(ahp_gt_get_max_speed(0) * SIDEREAL_DAY / M_PI / 2) + "x");
-        ui->Coil_0->setCurrentIndex(ahp_gt_get_stepping_conf(0));
-        ui->SteppingMode_0->setCurrentIndex(ahp_gt_get_stepping_mode(0));
-        ui->Invert_0->setChecked(ahp_gt_get_direction_invert(0));
-        ui->Timing_label_0->setText("Timing: " + QString::number(ui->Timing_0->value() * 100.0 / 1500000.0 / 100.0) + " %");
+        (axis == 0 ? ui->Divider0 : ui->Divider1)->setText(QString::number(view.model.divider));
+        (axis == 0 ? ui->Multiplier0 : ui->Multiplier1)->setText(QString::number(view.model.multiplier));
+        (axis == 0 ? ui->WormSteps0 : ui->WormSteps1)->setText(QString::number(view.model.wormsteps));
+        (axis == 0 ? ui->TotalSteps0 : ui->TotalSteps1)->setText(QString::number(view.model.totalsteps));
     }
-    else if (axis == 1)
-    {
-        double totalsteps = ahp_gt_get_totalsteps(1) * ahp_gt_get_divider(1) / ahp_gt_get_multiplier(1);
-        ui->Divider1->setText(QString::number(ahp_gt_get_divider(1)));
-        ui->Multiplier1->setText(QString::number(ahp_gt_get_multiplier(1)));
-        ui->WormSteps1->setText(QString::number(ahp_gt_get_wormsteps(1)));
-        ui->TotalSteps1->setText(QString::number(ahp_gt_get_totalsteps(1)));
-        ui->TrackingFrequency_1->setText("Steps/s: " + QString::number(totalsteps / SIDEREAL_DAY));
-        ui->SPT_1->setText("sec/turn: " + QString::number(SIDEREAL_DAY / (ahp_gt_get_crown_teeth(1)*ahp_gt_get_worm_teeth(
-                               1) / ahp_gt_get_motor_teeth(1))));
-        double L = (double)ui->Inductance_1->value() / 1000000.0;
-        double R = (double)ui->Resistance_1->value() / 1000.0;
-        double mI = (double)ui->Current_1->value() / 1000.0;
-        double mV = (double)ui->Voltage_1->value();
-        double Z = sqrt(fmax(0, pow(mV / mI, 2.0) - pow(R, 2.0)));
-        double f = (2.0 * M_PI * Z / L);
-        ui->PWMFrequency_1->setText("PWM Hz: " + QString::number(f));
-        ui->GotoFrequency_1->setText("Goto Hz: " + QString::number(totalsteps * ahp_gt_get_max_speed(1) / M_PI / 2));
-        ui->MotorSteps_1->setValue(ahp_gt_get_motor_steps(1));
-        ui->Motor_1->setValue(ahp_gt_get_motor_teeth(1));
-        ui->Worm_1->setValue(ahp_gt_get_worm_teeth(1));
-        ui->Crown_1->setValue(ahp_gt_get_crown_teeth(1));
-        ui->Acceleration_1->setValue(ui->Acceleration_1->maximum() - ahp_gt_get_acceleration_angle(1) * 1800.0 / M_PI);
-        ui->MaxSpeed_1->setMaximum(2000);
-        ui->Dec_Speed->setMaximum(2000);
-        ui->MaxSpeed_1->setValue(ahp_gt_get_max_speed(1) * SIDEREAL_DAY / M_PI / 2);
-        ui->MaxSpeed_label_1->setText("Maximum speed: " + QString::number(ahp_gt_get_max_speed(1) * SIDEREAL_DAY / M_PI / 2) + "x");
-        ui->Coil_1->setCurrentIndex(ahp_gt_get_stepping_conf(1));
-        ui->SteppingMode_1->setCurrentIndex(ahp_gt_get_stepping_mode(1));
-        ui->Invert_1->setChecked(ahp_gt_get_direction_invert(1));
-        ui->Timing_label_1->setText("Timing: " + QString::number(ui->Timing_1->value() * 100.0 / 1500000.0 / 100.0) + " %");
-    }
-    switch(ahp_gt_get_feature(0))
+    if(changed & ViewModel::FrequencyField)
     {
-        case GpioUnused:
-            ui->GPIO_0->setCurrentIndex(0);
-            break;
-        case GpioAsST4:
-            ui->GPIO_0->setCurrentIndex(1);
-            break;
-        case GpioAsPulseDrive:
-            ui->GPIO_0->setCurrentIndex(2);
-            break;
-        default:
-            break;
+        (axis == 0 ? ui->TrackingFrequency_0 : ui->TrackingFrequency_1)->setText("Steps/s: " + QString::number(view.model.tracking_frequency));
+        (axis == 0 ? ui->SPT_0 : ui->SPT_1)->setText("sec/turn: " + QString::number(view.model.seconds_per_turn));
+        (axis == 0 ? ui->GotoFrequency_0 : ui->GotoFrequency_1)->setText("Goto Hz: " + QString::number(view.model.goto_frequency));
     }
-    switch(ahp_gt_get_feature(1))
+    if(changed & ViewModel::MotorPwmField)
+        (axis == 0 ? ui->PWMFrequency_0 : ui->PWMFrequency_1)->setText("PWM Hz: " + QString::number(view.motor_pwm));
+    if(changed & ViewModel::MotorStepsField)
+        (axis == 0 ? ui->MotorSteps_0 : ui->MotorSteps_1)->setValue(view.motor_steps);
+    if(changed & ViewModel::MotorTeethField)
+        (axis == 0 ? ui->Motor_0 : ui->Motor_1)->setValue(view.motor_teeth);
+    if(changed & ViewModel::WormTeethField)
+        (axis == 0 ? ui->Worm_0 : ui->Worm_1)->setValue(view.worm_teeth);
+    if(changed & ViewModel::CrownTeethField)
+        (axis == 0 ? ui->Crown_0 : ui->Crown_1)->setValue(view.crown_teeth);
+    if(changed & ViewModel::AccelerationField)
+    {
+        QSlider *acceleration = (axis == 0 ? ui->Acceleration_0 : ui->Acceleration_1);
+        acceleration->setValue(acceleration->maximum() - view.acceleration * 1800.0 / M_PI);
+    }
+    if(changed & ViewModel::MaxSpeedField)
     {
-        case GpioUnused:
-            ui->GPIO_1->setCurrentIndex(0);
-            break;
-        case GpioAsST4:
-            ui->GPIO_1->setCurrentIndex(1);
-            break;
-        case GpioAsPulseDrive:
-            ui->GPIO_1->setCurrentIndex(2);
-            break;
-        default:
-            break;
+        QSlider *maxSpeed = (axis == 0 ? ui->MaxSpeed_0 : ui->MaxSpeed_1);
+        maxSpeed->setMaximum(2000);
+        (axis == 0 ? ui->Ra_Speed : ui->Dec_Speed)->setMaximum(2000);
+        maxSpeed->setValue(view.model.max_speed);
+        (axis == 0 ? ui->MaxSpeed_label_0 : ui->MaxSpeed_label_1)->setText("Maximum speed: " + QString::number(view.model.max_speed) + "x");
     }
-    ui->PWMFreq->setValue(ahp_gt_get_pwm_frequency(0));
-    ui->PWMFreq->setValue(ahp_gt_get_pwm_frequency(1));
-    ui->PWMFreq_label->setText("PWM: " + QString::number(366 + 366 * ui->PWMFreq->value()) + " Hz");
-    ui->MountType->setCurrentIndex(mounttypes.indexOf(ahp_gt_get_mount_type()));
-    int index = 0;
-    index |= (((ahp_gt_get_features(0) & isAZEQ) != 0) ? 2 : 0);
-    index |= (((ahp_gt_get_features(1) & isAZEQ) != 0) ? 2 : 0);
-    if(!index) {
-        index |= (((ahp_gt_get_mount_flags() & isForkMount) != 0) ? 1 : 0);
+    if(changed & ViewModel::CoilField)
+        (axis == 0 ? ui->Coil_0 : ui->Coil_1)->setCurrentIndex(view.stepping_conf);
+    if(changed & ViewModel::SteppingModeField)
+        (axis == 0 ? ui->SteppingMode_0 : ui->SteppingMode_1)->setCurrentIndex(view.stepping_mode);
+    if(changed & ViewModel::InvertField)
+        (axis == 0 ? ui->Invert_0 : ui->Invert_1)->setChecked(view.direction_invert);
+    if(changed & ViewModel::TimingField)
+        (axis == 0 ? ui->Timing_label_0 : ui->Timing_label_1)->setText("Timing: " + QString::number(view.timing * 100.0 / 1500000.0 / 100.0) + " %");
+    if(changed & ViewModel::GpioField)
+    {
+        QComboBox *gpio = (axis == 0 ? ui->GPIO_0 : ui->GPIO_1);
+        switch(view.feature)
+        {
+            case GpioUnused:
+                gpio->setCurrentIndex(0);
+                break;
+            case GpioAsST4:
+                gpio->setCurrentIndex(1);
+                break;
+            case GpioAsPulseDrive:
+                gpio->setCurrentIndex(2);
+                break;
+            default:
+                break;
+        }
     }
-    ui->MountStyle->setCurrentIndex(index);
-    ui->HighBauds->setChecked((ahp_gt_get_mount_flags() & bauds_115200) != 0);
     disconnectControls(false);
 }
 
-QString MainWindow::toDMS(double dms)
-{
-    double d, m, s;
-    dms = fabs(dms);
-    d = floor(dms);
-    dms -= d;
-    dms *= 60.0;
-    m = floor(dms);
-    dms -= m;
-    dms *= 60000.0;
-    s = floor(dms) / 1000.0;
-    return QString::number(d) + QString(":") + QString::number(m) + QString(":") + QString::number(s);
-}
-
-double* MainWindow::toDms(double d)
+void MainWindow::UpdateMount()
 {
-    double* dms = (double*)malloc(sizeof(double) * 3);
-    dms[0] = floor(d);
-    d -= dms[0];
-    d *= 60.0;
-    dms[1] = floor(d);
-    d -= dms[1];
-    d *= 60.0;
-    dms[2] = d;
-    return dms;
-}
-
-QString MainWindow::toHMS(double hms)
-{
-    double h, m, s;
-    hms = fabs(hms);
-    h = floor(hms);
-    hms -= h;
-    hms *= 60.0;
-    m = floor(hms);
-    hms -= m;
-    hms *= 60000.0;
-    s = floor(hms) / 1000.0;
-    return QString::number(h) + QString(":") + QString::number(m) + QString(":") + QString::number(s);
-}
-
-double MainWindow::fromHMSorDMS(QString dms)
-{
-    double d;
-    double m;
-    double s;
-    QStringList deg = dms.split(":");
-    d = deg[0].toDouble();
-    m = deg[1].toDouble() / 60.0 * (d < 0 ? -1 : 1);
-    s = deg[2].toDouble() / 3600.0 * (d < 0 ? -1 : 1);
-    return d + m + s;
+    TRACE_SCOPE("UpdateMount");
+    MountView view = MountView::fromLibrary();
+    int changed = viewModel.update(view);
+    if(!changed)
+        return;
+    disconnectControls(true);
+    if(changed & ViewModel::PwmFrequencyField)
+    {
+        ui->PWMFreq->setValue(view.pwm_frequency);
+        ui->PWMFreq_label->setText("PWM: " + QString::number(controllerPwmFrequency(ui->PWMFreq->value())) + " Hz");
+    }
+    if(changed & ViewModel::MountTypeField)
+        ui->MountType->setCurrentIndex(mounttypes.indexOf(view.mount_type));
+    if(changed & ViewModel::MountStyleField)
+        ui->MountStyle->setCurrentIndex(view.mount_style);
+    if(changed & ViewModel::HighBaudsField)
+        ui->HighBauds->setChecked(view.high_bauds);
+    disconnectControls(false);
 }
@@ -9,16 +9,126 @@
 #include <QUdpSocket>
 #include <QDateTime>
 #include <QStandardPaths>
+#include <QCheckBox>
+#include <QComboBox>
+#include <QSlider>
+#include <QSpinBox>
+#include <functional>
 #include <ahp_gt.h>
 #include "threads.h"
+#include "telemetry.h"
+#include "settingsstore.h"
+#include "deviceimage.h"
+#include "profile.h"
+#include "parameters.h"
+#include "profilefile.h"
+#include "profilelibrary.h"
+#include "profiletransaction.h"
+#include "conversions.h"
+#include "axismodel.h"
+#include "firmware.h"
+#include "busconfig.h"
+#include "discovery.h"
+#include "trace.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui
 {
 class MainWindow;
 }
+class QMenu;
 QT_END_NAMESPACE
 
+///How an axis parameter binding reads, writes and watches each kind of control
+template <class Widget> struct ControlTraits;
+
+template <> struct ControlTraits<QSpinBox>
+{
+    static int value(QSpinBox *w)
+    {
+        return w->value();
+    }
+    static void setValue(QSpinBox *w, int value)
+    {
+        w->setValue(value);
+    }
+    static void setRange(QSpinBox *w, int minimum, int maximum)
+    {
+        w->setRange(minimum, maximum);
+    }
+    template <class Slot>
+    static void connect(QSpinBox *w, QObject *context, Slot slot)
+    {
+        QObject::connect(w, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), context, slot);
+    }
+};
+
+template <> struct ControlTraits<QSlider>
+{
+    static int value(QSlider *w)
+    {
+        return w->value();
+    }
+    static void setValue(QSlider *w, int value)
+    {
+        w->setValue(value);
+    }
+    static void setRange(QSlider *w, int minimum, int maximum)
+    {
+        w->setRange(minimum, maximum);
+    }
+    template <class Slot>
+    static void connect(QSlider *w, QObject *context, Slot slot)
+    {
+        QObject::connect(w, static_cast<void (QSlider::*)(int)>(&QSlider::valueChanged), context, slot);
+    }
+};
+
+///The items come from the form, the range is left alone
+template <> struct ControlTraits<QComboBox>
+{
+    static int value(QComboBox *w)
+    {
+        return w->currentIndex();
+    }
+    static void setValue(QComboBox *w, int value)
+    {
+        w->setCurrentIndex(value);
+    }
+    static void setRange(QComboBox *, int, int)
+    {
+    }
+    template <class Slot>
+    static void connect(QComboBox *w, QObject *context, Slot slot)
+    {
+        QObject::connect(w, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), context, slot);
+    }
+};
+
+///Only user clicks are pushed, not programmatic changes
+template <> struct ControlTraits<QCheckBox>
+{
+    static int value(QCheckBox *w)
+    {
+        return w->isChecked();
+    }
+    static void setValue(QCheckBox *w, int value)
+    {
+        w->setChecked(value != 0);
+    }
+    static void setRange(QCheckBox *, int, int)
+    {
+    }
+    template <class Slot>
+    static void connect(QCheckBox *w, QObject *context, Slot slot)
+    {
+        QObject::connect(w, static_cast<void (QCheckBox::*)(bool)>(&QCheckBox::clicked), context, [ = ] (bool checked)
+        {
+            slot(checked);
+        });
+    }
+};
+
 class MainWindow : public QMainWindow
 {
         Q_OBJECT
@@ -30,6 +140,10 @@ class MainWindow : public QMainWindow
         int flashFirmware(const char *filename, int *progress, int *finished);
         void saveIni(QString ini);
         void readIni(QString ini);
+        ///Set the controls, libahp_gt and the settings from profile in one transaction, false if it does not validate
+        bool applyProfile(Profile profile, QString name = QString());
+        ///Profile as currently set in the controls
+        Profile currentProfile();
         inline QString getDefaultIni()
         {
             return ini;
@@ -49,31 +163,46 @@ class MainWindow : public QMainWindow
         double Ra {0.0};
         double Dec {0.0};
 
-        double* toDms(double d);
-        QString toHMS(double hms);
-        QString toDMS(double dms);
-        double fromHMSorDMS(QString dms);
-
         bool axis_lospeed[2] { false, false };
         bool axisdirection[2] { false, false };
-        double Speed[2];
-        double currentSteps[2];
-        SkywatcherAxisStatus status[2];
-        double lastPollTime[2];
-        double lastSteps[2];
-        double lastSpeeds[2][60] { { 0 }, { 0 }};
-        Thread *RaThread;
-        Thread *DecThread;
-        Thread *IndicationThread;
-        Thread *ProgressThread;
-        Thread *WriteThread;
-        Thread *ServerThread;
-        QSettings * settings;
+        TelemetrySampler telemetry;
+        Scheduler *scheduler;
+        int TelemetryJob;
+        int IndicationJob;
+        int ProgressJob;
+        int WriteJob { -1 };
+        int ServerJob { -1 };
+        int CorrectionJob[2] { -1, -1 };
+        std::function<void()> writeJob;
+        ///Run writeJob on the pool, done is called on the GUI thread after it; false if one is running
+        bool startWrite(std::function<void()> done = nullptr);
+        std::function<void()> writeDone;
+        void writeFinished();
+        ///Start, stop and correct tracking as the sampled status asks, on the GUI thread
+        void updateTracking(TelemetrySnapshot snapshot);
+        SettingsStore * settings;
+        FirmwareCatalog *catalog;
+        DifferentialWriter writer;
+        bool forceWrite { false };
+        ///write the profile to every bus address up to the selected one
+        bool busWrite { false };
         QString ini;
-        QString firmwareFilename;
+        FirmwareStore *firmwareStore;
+        DeviceCache *deviceCache;
+        ProfileLibrary *library;
+        ///Add the library entry index to menu, applied when triggered
+        void addLibraryAction(QMenu *menu, int index);
+        ///what genFirmware() prepared for the next flash
+        QByteArray firmwareImage;
+        ///keeps firmwareImage mapped when it comes from the store
+        FirmwareStore::Mapping firmwareMapping;
+        QString firmwareProduct;
+        QString firmwareVersion;
         QUdpSocket socket;
         bool online_resource { false };
         int percent { 0 };
+        ///size of the image being flashed, 0 when not flashing
+        int flashBytes { 0 };
         int finished { 1 };
         int threadsStopped;
         bool isConnected;
@@ -83,11 +212,43 @@ class MainWindow : public QMainWindow
         int stop_correction[2] { true, true };
         bool initial;
         int timer { 1000 };
-        QStringList CheckFirmware(QString url, int timeout_ms);
-        bool DownloadFirmware(QString url, QString filename, QSettings *settings, int timeout_ms = 30000);
         void genFirmware();
+        ///Firmware version reported by the controller on port, -1 if it does not answer
+        int deviceFirmwareVersion(QString port);
+        enum FlashResult
+        {
+            FlashDone,
+            FlashIdentical,
+            FlashError,
+        };
+        ///Flash image to the controller on port unless the hash recorded here for it matches and
+        ///ahp_gt_get_mc_version() still reports the version it had after that flash
+        FlashResult flashDevice(QString port, const QByteArray &image, bool force, int *progress, int *done, QString *error);
+        ///Probe the ports in the background, the controllers found are listed first
+        void discoverPorts();
+        PortDiscovery *discovery;
         void disconnectControls(bool block);
+        ///Make value the current bus address, copying the configuration to it
+        void selectAddress(int value);
+        ///Controls of one axis parameter, filled by bindAxisParameter
+        struct AxisBinding
+        {
+            QWidget *widget[2] { nullptr, nullptr };
+            std::function<int(int axis)> value;
+            std::function<void(int axis, int value)> setValue;
+            ///what the handler does besides pushing the value and saving
+            std::function<void(int axis, int value)> changed;
+        };
+        AxisBinding axisBindings[AXIS_PARAMETERS];
+        ///Push changes of the key parameter on both axes to the library and the profile,
+        ///changed runs after the library call for what the table does not cover
+        template <class Widget>
+        void bindAxisParameter(const char *key, Widget *axis0, Widget *axis1, std::function<void(int axis, int value)> changed = nullptr);
+        ///Render what changed in the axis controls since the last call
         void UpdateValues(int axis);
+        ///Same for the mount-wide controls
+        void UpdateMount();
+        ViewModel viewModel;
         Ui::MainWindow *ui;
         bool oldTracking[2] { false, false };
         bool isTracking[2] { false, false };
@@ -95,4 +256,39 @@ class MainWindow : public QMainWindow
         QMutex RAmutex, DEmutex;
         QMutex mutex;
         };
+
+template <class Widget>
+void MainWindow::bindAxisParameter(const char *key, Widget *axis0, Widget *axis1, std::function<void(int axis, int value)> changed)
+{
+    int index = axisParameterIndex(key);
+    if(index < 0)
+        return;
+    const AxisParameter &parameter = axisParameters[index];
+    AxisBinding &binding = axisBindings[index];
+    binding.widget[0] = axis0;
+    binding.widget[1] = axis1;
+    binding.value = [ = ] (int axis)
+    {
+        return ControlTraits<Widget>::value(axis == 0 ? axis0 : axis1);
+    };
+    binding.setValue = [ = ] (int axis, int value)
+    {
+        ControlTraits<Widget>::setValue(axis == 0 ? axis0 : axis1, value);
+    };
+    binding.changed = changed;
+    for(int a = 0; a < 2; a++)
+    {
+        Widget *widget = (a == 0 ? axis0 : axis1);
+        ControlTraits<Widget>::setRange(widget, parameter.minimum, parameter.maximum);
+        ControlTraits<Widget>::connect(widget, this, [ = ] (int value)
+        {
+            TRACE_SCOPE(parameter.key);
+            if(parameter.set)
+                parameter.set(a, value);
+            if(changed)
+                changed(a, value);
+            saveIni(ini);
+        });
+    }
+}
 #endif // MAINWINDOW_H
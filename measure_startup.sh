@@ -0,0 +1,16 @@
+#!/bin/bash
+#startup time and resident memory of the headless daemon, run in-process and as its own binary
+#usage: ./measure_startup.sh <build dir> [runs]
+build=${1:-build}
+runs=${2:-10}
+export QT_QPA_PLATFORM=${QT_QPA_PLATFORM:-offscreen}
+measure() {
+    name=$1
+    shift
+    for i in $(seq 1 $runs); do
+        /usr/bin/time -f "%e %M" "$@" 2>&1 >/dev/null | tail -n 1
+    done | awk -v name="$name" '{ t += $1; m += $2 } END { printf "%s: %.3f s wall, %.0f KiB max rss (mean of %d runs)\n", name, t / NR, m / NR, NR }'
+    "$@" | tail -n 1
+}
+measure "--headless" $build/gt-configurator --headless --startup-only
+measure "headless binary" $build/gt-configurator-headless --startup-only
@@ -0,0 +1,247 @@
+#include "parameters.h"
+#include <cmath>
+#include <cstring>
+
+static int getInvert(int a)
+{
+    return ahp_gt_get_direction_invert(a) == 1;
+}
+
+static void setInvert(int a, int value)
+{
+    ahp_gt_set_direction_invert(a, value);
+}
+
+static int getSteppingMode(int a)
+{
+    return ahp_gt_get_stepping_mode(a);
+}
+
+static void setSteppingMode(int a, int value)
+{
+    ahp_gt_set_stepping_mode(a, (GTSteppingMode)value);
+}
+
+static int getMotorSteps(int a)
+{
+    return ahp_gt_get_motor_steps(a);
+}
+
+static void setMotorSteps(int a, int value)
+{
+    ahp_gt_set_motor_steps(a, value);
+}
+
+static int getWorm(int a)
+{
+    return ahp_gt_get_worm_teeth(a);
+}
+
+static void setWorm(int a, int value)
+{
+    ahp_gt_set_worm_teeth(a, value);
+}
+
+static int getMotor(int a)
+{
+    return ahp_gt_get_motor_teeth(a);
+}
+
+static void setMotor(int a, int value)
+{
+    ahp_gt_set_motor_teeth(a, value);
+}
+
+static int getCrown(int a)
+{
+    return ahp_gt_get_crown_teeth(a);
+}
+
+static void setCrown(int a, int value)
+{
+    ahp_gt_set_crown_teeth(a, value);
+}
+
+///Acceleration counts down from PROFILE_ACCELERATION_MAX in tenths of degree
+static int getAcceleration(int a)
+{
+    return PROFILE_ACCELERATION_MAX - ahp_gt_get_acceleration_angle(a) * 1800.0 / M_PI;
+}
+
+static void setAcceleration(int a, int value)
+{
+    ahp_gt_set_acceleration_angle(a, (PROFILE_ACCELERATION_MAX - value) * M_PI / 1800.0);
+}
+
+///Maximum speed as a multiple of sidereal
+static int getMaxSpeed(int a)
+{
+    return ahp_gt_get_max_speed(a) * SIDEREAL_DAY / M_PI / 2;
+}
+
+static void setMaxSpeed(int a, int value)
+{
+    ahp_gt_set_max_speed(a, value * M_PI * 2 / SIDEREAL_DAY);
+}
+
+static int getCoil(int a)
+{
+    return ahp_gt_get_stepping_conf(a);
+}
+
+static void setCoil(int a, int value)
+{
+    ahp_gt_set_stepping_conf(a, (GTSteppingConfiguration)value);
+}
+
+///GPIO combo index: unused, ST4, pulse drive
+static int getGpio(int a)
+{
+    switch(ahp_gt_get_feature(a))
+    {
+        case GpioUnused:
+            return 0;
+        case GpioAsST4:
+            return 1;
+        case GpioAsPulseDrive:
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+static void setGpio(int a, int value)
+{
+    switch(value)
+    {
+        case 0:
+            ahp_gt_set_feature(a, GpioUnused);
+            break;
+        case 1:
+            ahp_gt_set_feature(a, GpioAsST4);
+            break;
+        case 2:
+            ahp_gt_set_feature(a, GpioAsPulseDrive);
+            break;
+        default:
+            break;
+    }
+}
+
+///Timing in hundredths of percent around the nominal 1.5 s
+static void setTiming(int a, int value)
+{
+    ahp_gt_set_timing(a, -value * 1500000.0 / 10000.0 + 1500000.0);
+}
+
+///Profile::apply() pushes in table order: the library derives the speed limits
+///from the gearing, so maximum speed and acceleration come after it
+constexpr AxisParameter axisParameters[AXIS_PARAMETERS] =
+{
+    { "Timing", &AxisProfile::timing, IntegerParameter, -1000, 1000, 0, nullptr, setTiming },
+    { "MotorSteps", &AxisProfile::motor_steps, IntegerParameter, 1, 16777215, 200, getMotorSteps, setMotorSteps },
+    { "Motor", &AxisProfile::motor, IntegerParameter, 1, 16777215, 1, getMotor, setMotor },
+    { "Worm", &AxisProfile::worm, IntegerParameter, 1, 16777215, 50, getWorm, setWorm },
+    { "Crown", &AxisProfile::crown, IntegerParameter, 1, 16777215, 1, getCrown, setCrown },
+    { "Invert", &AxisProfile::invert, BooleanParameter, 0, 1, 0, getInvert, setInvert },
+    { "Coil", &AxisProfile::coil, IntegerParameter, 0, 2, 0, getCoil, setCoil },
+    { "SteppingMode", &AxisProfile::stepping_mode, IntegerParameter, 0, 2, 0, getSteppingMode, setSteppingMode },
+    { "GPIO", &AxisProfile::gpio, IntegerParameter, 0, 2, 0, getGpio, setGpio },
+    { "MaxSpeed", &AxisProfile::max_speed, IntegerParameter, 1, 2000, 800, getMaxSpeed, setMaxSpeed },
+    { "Acceleration", &AxisProfile::acceleration, IntegerParameter, 0, PROFILE_ACCELERATION_MAX, 0, getAcceleration, setAcceleration },
+    { "Inductance", &AxisProfile::inductance, IntegerParameter, 1, 1000000, 10, nullptr, nullptr },
+    { "Resistance", &AxisProfile::resistance, IntegerParameter, 1, 1000000, 20000, nullptr, nullptr },
+    { "Current", &AxisProfile::current, IntegerParameter, 1, 100000, 1000, nullptr, nullptr },
+    { "Voltage", &AxisProfile::voltage, IntegerParameter, 3, 240, 12, nullptr, nullptr },
+    { "Mean", &AxisProfile::mean, IntegerParameter, 1, 1000, 1, nullptr, nullptr },
+    { "Estimator", &AxisProfile::estimator, IntegerParameter, 0, 3, 0, nullptr, nullptr },
+};
+
+static_assert(sizeof(axisParameters) / sizeof(axisParameters[0]) == AXIS_PARAMETERS, "AXIS_PARAMETERS does not match the table");
+
+int axisParameterIndex(const char *key)
+{
+    for(int p = 0; p < AXIS_PARAMETERS; p++)
+    {
+        if(!strcmp(axisParameters[p].key, key))
+            return p;
+    }
+    return -1;
+}
+
+const QString &axisParameterKey(int parameter, int axis)
+{
+    //the QString keys are the costly part of a lookup, build them once
+    static struct Keys
+    {
+        QString key[AXIS_PARAMETERS][2];
+        Keys()
+        {
+            for(int p = 0; p < AXIS_PARAMETERS; p++)
+            {
+                for(int a = 0; a < 2; a++)
+                    key[p][a] = QString(axisParameters[p].key) + "_" + QString::number(a);
+            }
+        }
+    } keys;
+    return keys.key[parameter][axis];
+}
+
+static int applyMountType(const Profile &profile)
+{
+    ahp_gt_set_mount_type((MountType)mounttypes.value(profile.mount_type, mounttypes[0]));
+    return 1;
+}
+
+///Fork and AZ-EQ style, together with the half current features
+static int applyMountStyle(const Profile &profile)
+{
+    int flags = ahp_gt_get_mount_flags();
+    int features = ahp_gt_get_features(0);
+    features &= ~(isAZEQ | hasHalfCurrentTracking);
+    features |= hasCommonSlewStart;
+    features |= (profile.half_current ? hasHalfCurrentTracking : 0);
+    features |= (profile.mount_style == 2 ? isAZEQ : 0);
+    flags &= ~isForkMount;
+    flags &= ~bauds_115200;
+    flags |= (profile.mount_style == 1 ? isForkMount : 0);
+    flags |= halfCurrentRA;
+    flags |= halfCurrentDec;
+    ahp_gt_set_mount_flags((GTFlags)flags);
+    ahp_gt_set_features(0, (SkywatcherFeature)features);
+    ahp_gt_set_features(1, (SkywatcherFeature)features);
+    return 3;
+}
+
+static int applyPWMFreq(const Profile &profile)
+{
+    ahp_gt_set_pwm_frequency(0, profile.pwm_frequency);
+    ahp_gt_set_pwm_frequency(1, profile.pwm_frequency);
+    return 2;
+}
+
+static int applyAddress(const Profile &profile)
+{
+    ahp_gt_select_device(profile.address);
+    return 1;
+}
+
+const MountParameter mountParameters[MOUNT_PARAMETERS] =
+{
+    { "MountType", applyMountType },
+    { "MountStyle", applyMountStyle },
+    { "PWMFreq", applyPWMFreq },
+    { "Address", applyAddress },
+};
+
+static_assert(sizeof(mountParameters) / sizeof(mountParameters[0]) == MOUNT_PARAMETERS, "MOUNT_PARAMETERS does not match the table");
+
+int mountParameterIndex(const char *key)
+{
+    for(int p = 0; p < MOUNT_PARAMETERS; p++)
+    {
+        if(!strcmp(mountParameters[p].key, key))
+            return p;
+    }
+    return -1;
+}
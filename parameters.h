@@ -0,0 +1,60 @@
+#ifndef PARAMETERS_H
+#define PARAMETERS_H
+
+#include <QString>
+#include "profile.h"
+
+///Per-axis settings of a profile
+#define AXIS_PARAMETERS 17
+
+///How a setting is stored in the INI profile
+enum ParameterKind
+{
+    IntegerParameter,
+    BooleanParameter,
+};
+
+///One per-axis setting: INI key, place in AxisProfile, range and how it maps to
+///the library. Loading, saving, diffing and pushing a profile are loops over
+///axisParameters, the window binds its controls from the same table.
+struct AxisParameter
+{
+    ///INI key, stored with the axis appended as _0 and _1
+    const char *key;
+    int AxisProfile::*field;
+    ParameterKind kind;
+    int minimum;
+    int maximum;
+    ///Value when neither the INI file nor the library has one
+    int fallback;
+    ///Library value in profile units, nullptr if the library does not hold it
+    int (*get)(int axis);
+    ///Push a value in profile units to the library, nullptr for settings of the configurator only
+    void (*set)(int axis, int value);
+};
+
+extern const AxisParameter axisParameters[AXIS_PARAMETERS];
+
+///Index of key in axisParameters, -1 if there is no such parameter
+int axisParameterIndex(const char *key);
+///INI key of parameter on axis, built once
+const QString &axisParameterKey(int parameter, int axis);
+
+///Mount-wide settings the library holds
+#define MOUNT_PARAMETERS 4
+
+///One mount-wide setting: INI key and how it is pushed to the library.
+///Profile::apply() pushes them in table order.
+struct MountParameter
+{
+    const char *key;
+    ///Push the setting of profile to the library, returns the library calls made
+    int (*apply)(const Profile &profile);
+};
+
+extern const MountParameter mountParameters[MOUNT_PARAMETERS];
+
+///Index of key in mountParameters, -1 if there is no such parameter
+int mountParameterIndex(const char *key);
+
+#endif // PARAMETERS_H
@@ -0,0 +1,150 @@
+#include "profile.h"
+#include "parameters.h"
+#include "profilefile.h"
+#include <cmath>
+#include <QSettings>
+
+const QList<int> mounttypes({
+    ///Sky-Watcher EQ6
+    0x00,
+    ///Sky-Watcher HEQ5
+    0x01,
+    ///Sky-Watcher EQ5
+    0x02,
+    ///Sky-Watcher EQ3
+    0x03,
+    ///Sky-Watcher EQ8
+    0x04,
+    ///Sky-Watcher AZEQ6
+    0x05,
+    ///Sky-Watcher AZEQ5
+    0x06,
+    ///Sky-Watcher GT
+    0x80,
+    ///Fork Mount
+    0x81,
+    ///114GT
+    0x82,
+    ///Dobsonian mount
+    0x90,
+    ///Custom mount
+    0xF0,
+});
+
+Profile Profile::load(QString ini)
+{
+    Profile p;
+    if(ini.endsWith(BINARY_PROFILE_SUFFIX))
+    {
+        if(BinaryProfile::read(ini, &p))
+            return p;
+        //a damaged binary profile gets the library values, like an empty INI file
+        ini.clear();
+    }
+    QSettings settings(ini, QSettings::Format::IniFormat);
+    p.notes = QByteArray::fromBase64(settings.value("Notes").toString().toUtf8());
+    p.address = settings.value("Address", 0).toInt();
+    p.pwm_frequency = settings.value("PWMFreq", ahp_gt_get_pwm_frequency(0)).toInt();
+    p.mount_type = settings.value("MountType", 0).toInt();
+    p.mount_style = settings.value("MountStyle", 0).toInt();
+    p.high_bauds = settings.value("HighBauds", false).toBool();
+    p.half_current = settings.value("HalfCurrent", false).toBool();
+    p.ra = settings.value("Ra", 0).toDouble();
+    p.dec = settings.value("Dec", 0).toDouble();
+    p.latitude = settings.value("Latitude", 0).toDouble();
+    p.longitude = settings.value("Longitude", 0).toDouble();
+    p.last_port = settings.value("LastPort", "").toString();
+    for(int a = 0; a < 2; a++)
+    {
+        for(int i = 0; i < AXIS_PARAMETERS; i++)
+        {
+            const AxisParameter &parameter = axisParameters[i];
+            int fallback = parameter.get ? parameter.get(a) : parameter.fallback;
+            QVariant value = settings.value(axisParameterKey(i, a));
+            int v = !value.isValid() ? fallback : parameter.kind == BooleanParameter ? value.toBool() : value.toInt();
+            p.axis[a].*parameter.field = qBound(parameter.minimum, v, parameter.maximum);
+        }
+    }
+    return p;
+}
+
+int Profile::apply() const
+{
+    int calls = 0;
+    for(int i = 0; i < MOUNT_PARAMETERS; i++)
+        calls += mountParameters[i].apply(*this);
+    for(int a = 0; a < 2; a++)
+        calls += applyAxis(a);
+    return calls;
+}
+
+int Profile::applyAxis(int a, int first) const
+{
+    int calls = 0;
+    for(int i = first; i < AXIS_PARAMETERS; i++)
+    {
+        if(axisParameters[i].set)
+        {
+            axisParameters[i].set(a, axis[a].*axisParameters[i].field);
+            calls++;
+        }
+    }
+    return calls;
+}
+
+void Profile::save(SettingsStore *settings) const
+{
+    for(int a = 0; a < 2; a++)
+    {
+        for(int i = 0; i < AXIS_PARAMETERS; i++)
+        {
+            const AxisParameter &parameter = axisParameters[i];
+            int value = axis[a].*parameter.field;
+            if(parameter.kind == BooleanParameter)
+                settings->setValue(axisParameterKey(i, a), value != 0);
+            else
+                settings->setValue(axisParameterKey(i, a), value);
+        }
+    }
+    settings->setValue("MountType", mount_type);
+    settings->setValue("Address", address);
+    settings->setValue("PWMFreq", pwm_frequency);
+    settings->setValue("MountStyle", mount_style);
+    settings->setValue("Notes", QString(notes.toUtf8().toBase64()));
+    settings->setValue("Ra", ra);
+    settings->setValue("Dec", dec);
+    settings->setValue("Latitude", latitude);
+    settings->setValue("Longitude", longitude);
+}
+
+QStringList Profile::diff(const Profile &other) const
+{
+    QStringList changed;
+    for(int a = 0; a < 2; a++)
+    {
+        for(int i = 0; i < AXIS_PARAMETERS; i++)
+        {
+            if(axis[a].*axisParameters[i].field != other.axis[a].*axisParameters[i].field)
+                changed.append(axisParameterKey(i, a));
+        }
+    }
+    if(mount_type != other.mount_type)
+        changed.append("MountType");
+    if(address != other.address)
+        changed.append("Address");
+    if(pwm_frequency != other.pwm_frequency)
+        changed.append("PWMFreq");
+    if(mount_style != other.mount_style)
+        changed.append("MountStyle");
+    if(notes != other.notes)
+        changed.append("Notes");
+    if(ra != other.ra)
+        changed.append("Ra");
+    if(dec != other.dec)
+        changed.append("Dec");
+    if(latitude != other.latitude)
+        changed.append("Latitude");
+    if(longitude != other.longitude)
+        changed.append("Longitude");
+    return changed;
+}
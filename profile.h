@@ -0,0 +1,70 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <ahp_gt.h>
+#include "settingsstore.h"
+
+///Range of the acceleration slider, the stored value counts down from it in tenths of degree
+#define PROFILE_ACCELERATION_MAX 100
+
+static const double SIDEREAL_DAY = 86164.0916000;
+static const double SIDEREAL_NOON = (SIDEREAL_DAY / 2);
+
+///Mount type codes, indexed like the MountType combo box
+extern const QList<int> mounttypes;
+
+///Axis settings as stored in the INI profile, in the units of the configurator controls
+struct AxisProfile
+{
+    int invert;
+    int stepping_mode;
+    int motor_steps;
+    int worm;
+    int motor;
+    int crown;
+    int acceleration;
+    int max_speed;
+    int coil;
+    int gpio;
+    int inductance;
+    int resistance;
+    int current;
+    int voltage;
+    int mean;
+    int estimator;
+    int timing;
+};
+
+///Widget-free view of an INI profile, shared by the configurator window and the headless daemon
+struct Profile
+{
+    int mount_type;
+    int address;
+    int pwm_frequency;
+    int mount_style;
+    bool high_bauds;
+    bool half_current;
+    QString notes;
+    double ra;
+    double dec;
+    double latitude;
+    double longitude;
+    QString last_port;
+    AxisProfile axis[2];
+
+    ///Read ini or a binary profile, missing keys fall back to what the library currently holds
+    static Profile load(QString ini);
+    ///Push the profile into the library, the controller is not written, returns the library calls made
+    int apply() const;
+    ///Push the parameters of axis from the one at index first of axisParameters on, returns the library calls made
+    int applyAxis(int axis, int first = 0) const;
+    ///Store the profile keys, LastPort, HighBauds and HalfCurrent are left as they are
+    void save(SettingsStore *settings) const;
+    ///INI keys whose values differ from other
+    QStringList diff(const Profile &other) const;
+};
+
+#endif // PROFILE_H
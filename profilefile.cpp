@@ -0,0 +1,208 @@
+#include "profilefile.h"
+#include "parameters.h"
+#include <cstring>
+#include <QFile>
+#include <QSaveFile>
+#include <QtEndian>
+
+///Version 1 layout, offsets in bytes:
+///   0 "GTPF"
+///   4 u16 layout version
+///   6 u16 parameters per axis
+///   8 u32 file size
+///  12 u16 CRC-16 (qChecksum) of everything from offset 16 to the end
+///  16 u32 flags: 1 high bauds, 2 half current
+///  20 i32 mount type, address, PWM frequency, mount style
+///  40 f64 ra, dec, latitude, longitude
+///  72 i32 axis 0 parameters, then axis 1
+///     u32 length and UTF-8 notes, u32 length and UTF-8 last port
+enum Layout
+{
+    MagicOffset = 0,
+    VersionOffset = 4,
+    CountOffset = 6,
+    SizeOffset = 8,
+    CrcOffset = 12,
+    HeaderSize = 16,
+    FlagsOffset = 16,
+    MountTypeOffset = 20,
+    AddressOffset = 24,
+    PwmFrequencyOffset = 28,
+    MountStyleOffset = 32,
+    RaOffset = 40,
+    DecOffset = 48,
+    LatitudeOffset = 56,
+    LongitudeOffset = 64,
+    AxesOffset = 72,
+};
+
+enum Flags
+{
+    HighBaudsFlag = 1,
+    HalfCurrentFlag = 2,
+};
+
+static const char magic[4] = { 'G', 'T', 'P', 'F' };
+
+template <class T>
+static void put(QByteArray *bytes, int offset, T value)
+{
+    qToLittleEndian<T>(value, reinterpret_cast<uchar *>(bytes->data() + offset));
+}
+
+template <class T>
+static T get(const uchar *data, qint64 offset)
+{
+    return qFromLittleEndian<T>(data + offset);
+}
+
+static void putDouble(QByteArray *bytes, int offset, double value)
+{
+    quint64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    put<quint64>(bytes, offset, bits);
+}
+
+static double getDouble(const uchar *data, qint64 offset)
+{
+    quint64 bits = get<quint64>(data, offset);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static bool fail(QString *error, QString message)
+{
+    if(error)
+        *error = message;
+    return false;
+}
+
+QByteArray BinaryProfile::encode(const Profile &p)
+{
+    QByteArray notes = p.notes.toUtf8();
+    QByteArray port = p.last_port.toUtf8();
+    int stringsOffset = AxesOffset + 2 * AXIS_PARAMETERS * 4;
+    QByteArray bytes(stringsOffset + 4 + notes.length() + 4 + port.length(), 0);
+    memcpy(bytes.data() + MagicOffset, magic, sizeof(magic));
+    put<quint16>(&bytes, VersionOffset, Version);
+    put<quint16>(&bytes, CountOffset, AXIS_PARAMETERS);
+    put<quint32>(&bytes, SizeOffset, bytes.length());
+    put<quint32>(&bytes, FlagsOffset, (p.high_bauds ? HighBaudsFlag : 0) | (p.half_current ? HalfCurrentFlag : 0));
+    put<qint32>(&bytes, MountTypeOffset, p.mount_type);
+    put<qint32>(&bytes, AddressOffset, p.address);
+    put<qint32>(&bytes, PwmFrequencyOffset, p.pwm_frequency);
+    put<qint32>(&bytes, MountStyleOffset, p.mount_style);
+    putDouble(&bytes, RaOffset, p.ra);
+    putDouble(&bytes, DecOffset, p.dec);
+    putDouble(&bytes, LatitudeOffset, p.latitude);
+    putDouble(&bytes, LongitudeOffset, p.longitude);
+    int offset = AxesOffset;
+    for(int a = 0; a < 2; a++)
+    {
+        for(int i = 0; i < AXIS_PARAMETERS; i++, offset += 4)
+            put<qint32>(&bytes, offset, p.axis[a].*axisParameters[i].field);
+    }
+    put<quint32>(&bytes, offset, notes.length());
+    memcpy(bytes.data() + offset + 4, notes.constData(), notes.length());
+    offset += 4 + notes.length();
+    put<quint32>(&bytes, offset, port.length());
+    memcpy(bytes.data() + offset + 4, port.constData(), port.length());
+    put<quint16>(&bytes, CrcOffset, qChecksum(bytes.constData() + HeaderSize, bytes.length() - HeaderSize));
+    return bytes;
+}
+
+bool BinaryProfile::decode(const uchar *data, qint64 size, Profile *p, QString *error)
+{
+    if(size < AxesOffset || memcmp(data + MagicOffset, magic, sizeof(magic)))
+        return fail(error, "not a binary profile");
+    int version = get<quint16>(data, VersionOffset);
+    if(version > Version)
+        return fail(error, "profile layout version " + QString::number(version) + " is newer than this configurator");
+    if(get<quint32>(data, SizeOffset) != size)
+        return fail(error, "truncated profile");
+    if(get<quint16>(data, CrcOffset) != qChecksum(reinterpret_cast<const char *>(data) + HeaderSize, (uint)(size - HeaderSize)))
+        return fail(error, "profile checksum mismatch");
+    int count = get<quint16>(data, CountOffset);
+    qint64 offset = AxesOffset + 2 * count * 4;
+    if(offset + 4 > size)
+        return fail(error, "truncated profile");
+    quint32 flags = get<quint32>(data, FlagsOffset);
+    p->high_bauds = (flags & HighBaudsFlag) != 0;
+    p->half_current = (flags & HalfCurrentFlag) != 0;
+    p->mount_type = get<qint32>(data, MountTypeOffset);
+    p->address = get<qint32>(data, AddressOffset);
+    p->pwm_frequency = get<qint32>(data, PwmFrequencyOffset);
+    p->mount_style = get<qint32>(data, MountStyleOffset);
+    p->ra = getDouble(data, RaOffset);
+    p->dec = getDouble(data, DecOffset);
+    p->latitude = getDouble(data, LatitudeOffset);
+    p->longitude = getDouble(data, LongitudeOffset);
+    for(int a = 0; a < 2; a++)
+    {
+        for(int i = 0; i < AXIS_PARAMETERS; i++)
+        {
+            const AxisParameter &parameter = axisParameters[i];
+            //parameters newer than the file get what an INI file without the key would
+            int value = i < count ? get<qint32>(data, AxesOffset + (a * count + i) * 4) :
+                        parameter.get ? parameter.get(a) : parameter.fallback;
+            p->axis[a].*parameter.field = qBound(parameter.minimum, value, parameter.maximum);
+        }
+    }
+    quint32 length = get<quint32>(data, offset);
+    if(offset + 4 + length + 4 > (quint64)size)
+        return fail(error, "truncated profile");
+    p->notes = QString::fromUtf8(reinterpret_cast<const char *>(data) + offset + 4, length);
+    offset += 4 + length;
+    length = get<quint32>(data, offset);
+    if(offset + 4 + length > (quint64)size)
+        return fail(error, "truncated profile");
+    p->last_port = QString::fromUtf8(reinterpret_cast<const char *>(data) + offset + 4, length);
+    return true;
+}
+
+bool BinaryProfile::read(QString filename, Profile *profile, QString *error)
+{
+    QFile file(filename);
+    if(!file.open(QIODevice::ReadOnly))
+        return fail(error, file.errorString());
+    uchar *data = file.map(0, file.size());
+    if(data == nullptr)
+    {
+        //not every file system maps
+        QByteArray bytes = file.readAll();
+        return decode(reinterpret_cast<const uchar *>(bytes.constData()), bytes.length(), profile, error);
+    }
+    bool ok = decode(data, file.size(), profile, error);
+    file.unmap(data);
+    return ok;
+}
+
+bool BinaryProfile::write(QString filename, const Profile &profile)
+{
+    QByteArray bytes = encode(profile);
+    QSaveFile out(filename);
+    if(!out.open(QIODevice::WriteOnly) || out.write(bytes) != bytes.length())
+        return false;
+    return out.commit();
+}
+
+bool BinaryProfile::importIni(QString ini, QString filename)
+{
+    if(!QFile(ini).exists())
+        return false;
+    return write(filename, Profile::load(ini));
+}
+
+bool BinaryProfile::exportIni(QString filename, QString ini)
+{
+    Profile profile;
+    if(!read(filename, &profile))
+        return false;
+    SettingsStore settings(ini, 0);
+    profile.save(&settings);
+    settings.setValue("LastPort", profile.last_port);
+    settings.setValue("HighBauds", profile.high_bauds);
+    settings.setValue("HalfCurrent", profile.half_current);
+    return settings.commit();
+}
@@ -0,0 +1,35 @@
+#ifndef PROFILEFILE_H
+#define PROFILEFILE_H
+
+#include <QByteArray>
+#include <QString>
+#include "profile.h"
+
+///Suffix of binary profiles, Profile::load() reads them as well as INI files
+#define BINARY_PROFILE_SUFFIX ".gtp"
+
+///Binary profile: a fixed little-endian layout with a version and a CRC,
+///read straight from a memory-mapped file without any key lookup or
+///text conversion. The per-axis values follow the axisParameters order,
+///parameters added to the end of the table are still read from older files.
+class BinaryProfile
+{
+    public:
+        ///Layout version written by encode()
+        static const int Version = 1;
+
+        static QByteArray encode(const Profile &profile);
+        ///Fill profile from size bytes at data, false with error set on damaged or unknown data
+        static bool decode(const uchar *data, qint64 size, Profile *profile, QString *error = nullptr);
+        ///Map filename and decode it
+        static bool read(QString filename, Profile *profile, QString *error = nullptr);
+        ///Replace filename with the encoded profile, never leaves a partial file
+        static bool write(QString filename, const Profile &profile);
+
+        ///Convert an INI profile, keys missing from the INI get the library values like in Profile::load()
+        static bool importIni(QString ini, QString filename);
+        ///Convert to an INI profile, with LastPort, HighBauds and HalfCurrent
+        static bool exportIni(QString filename, QString ini);
+};
+
+#endif // PROFILEFILE_H
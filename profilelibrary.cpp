@@ -0,0 +1,260 @@
+#include "profilelibrary.h"
+#include "profilefile.h"
+#include <algorithm>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSettings>
+
+///"GTPL"
+static const quint32 libraryMagic = 0x4754504c;
+static const qint32 libraryVersion = 1;
+
+static qint64 gcd(qint64 a, qint64 b)
+{
+    while(b != 0)
+    {
+        qint64 r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+static bool matches(const ProfileLibrary::Entry &entry, const ProfileLibrary::Query &query)
+{
+    if(query.mountType >= 0 && entry.profile.mount_type != query.mountType)
+        return false;
+    if(query.address >= 0 && entry.profile.address != query.address)
+        return false;
+    if(query.firmware >= 0 && entry.firmware != query.firmware)
+        return false;
+    if(!query.device.isEmpty() && entry.device != query.device)
+        return false;
+    if(!query.gearing.isEmpty() && ProfileLibrary::gearing(entry.profile) != query.gearing)
+        return false;
+    return true;
+}
+
+ProfileLibrary::ProfileLibrary(QString f)
+{
+    filename = f;
+}
+
+bool ProfileLibrary::open()
+{
+    entries.clear();
+    reindex();
+    QFile file(filename);
+    if(!file.exists())
+        return true;
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+    quint32 magic;
+    qint32 version, count;
+    in >> magic >> version >> count;
+    if(in.status() != QDataStream::Ok || magic != libraryMagic || version > libraryVersion)
+        return false;
+    for(int i = 0; i < count && in.status() == QDataStream::Ok; i++)
+    {
+        Entry entry;
+        QByteArray bytes;
+        qint32 firmware;
+        in >> entry.name >> entry.device >> firmware >> bytes;
+        entry.firmware = firmware;
+        //a damaged profile costs that entry only, each one has its own CRC
+        if(in.status() == QDataStream::Ok &&
+                BinaryProfile::decode(reinterpret_cast<const uchar *>(bytes.constData()), bytes.length(), &entry.profile))
+        {
+            entries.append(entry);
+            index(entries.count() - 1);
+        }
+    }
+    return in.status() == QDataStream::Ok;
+}
+
+bool ProfileLibrary::save()
+{
+    QFileInfo info(filename);
+    if(!info.dir().exists())
+        QDir().mkpath(info.dir().path());
+    QSaveFile out(filename);
+    if(!out.open(QIODevice::WriteOnly))
+        return false;
+    QDataStream stream(&out);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << libraryMagic << libraryVersion << (qint32)entries.count();
+    for(const Entry &entry : entries)
+        stream << entry.name << entry.device << (qint32)entry.firmware << BinaryProfile::encode(entry.profile);
+    if(stream.status() != QDataStream::Ok)
+    {
+        out.cancelWriting();
+        return false;
+    }
+    return out.commit();
+}
+
+QStringList ProfileLibrary::names() const
+{
+    QStringList list;
+    for(const Entry &entry : entries)
+        list.append(entry.name);
+    return list;
+}
+
+int ProfileLibrary::add(const Entry &entry)
+{
+    int i = indexOf(entry.name);
+    if(i >= 0)
+    {
+        entries[i] = entry;
+        reindex();
+        return i;
+    }
+    entries.append(entry);
+    index(entries.count() - 1);
+    return entries.count() - 1;
+}
+
+bool ProfileLibrary::remove(QString name)
+{
+    int i = indexOf(name);
+    if(i < 0)
+        return false;
+    entries.removeAt(i);
+    reindex();
+    return true;
+}
+
+QList<int> ProfileLibrary::find(const Query &query) const
+{
+    QList<QList<int>> sets;
+    if(query.mountType >= 0)
+        sets.append(byMountType.values(query.mountType));
+    if(query.address >= 0)
+        sets.append(byAddress.values(query.address));
+    if(query.firmware >= 0)
+        sets.append(byFirmware.values(query.firmware));
+    if(!query.device.isEmpty())
+        sets.append(byDevice.values(query.device));
+    if(!query.gearing.isEmpty())
+        sets.append(byGearing.values(query.gearing));
+    QList<int> found;
+    if(sets.isEmpty())
+    {
+        for(int i = 0; i < entries.count(); i++)
+            found.append(i);
+        return found;
+    }
+    //walk the smallest set, the other fields are checked on its entries only
+    const QList<int> &candidates = *std::min_element(sets.begin(), sets.end(), [] (const QList<int> &a, const QList<int> &b)
+    {
+        return a.count() < b.count();
+    });
+    for(int i : candidates)
+    {
+        if(matches(entries[i], query))
+            found.append(i);
+    }
+    std::sort(found.begin(), found.end());
+    return found;
+}
+
+QList<int> ProfileLibrary::match(QString device, int firmware, int address, int mountType) const
+{
+    QHash<int, int> score;
+    if(!device.isEmpty())
+    {
+        for(int i : byDevice.values(device))
+            score[i] += 8;
+    }
+    //entries made for any firmware are indexed under -1 and do not count as a match
+    if(firmware >= 0)
+    {
+        for(int i : byFirmware.values(firmware))
+            score[i] += 4;
+    }
+    for(int i : byAddress.values(address))
+        score[i] += 2;
+    for(int i : byMountType.values(mountType))
+        score[i] += 1;
+    QList<int> found = score.keys();
+    std::sort(found.begin(), found.end(), [&] (int a, int b)
+    {
+        return score[a] != score[b] ? score[a] > score[b] : a < b;
+    });
+    return found;
+}
+
+int ProfileLibrary::importDirectory(QString dir, QStringList *failed)
+{
+    int imported = 0;
+    QStringList filters;
+    filters << "*.ini" << "*" BINARY_PROFILE_SUFFIX;
+    for(QFileInfo info : QDir(dir).entryInfoList(filters, QDir::Files, QDir::Name))
+    {
+        Entry entry;
+        entry.name = info.completeBaseName();
+        bool ok;
+        if(info.suffix() == QString(BINARY_PROFILE_SUFFIX).mid(1))
+            ok = BinaryProfile::read(info.filePath(), &entry.profile);
+        else
+        {
+            //the data directory also holds INI files that are not profiles
+            ok = QSettings(info.filePath(), QSettings::IniFormat).contains("MotorSteps_0");
+            if(ok)
+                entry.profile = Profile::load(info.filePath());
+        }
+        if(!ok)
+        {
+            if(failed)
+                failed->append(info.filePath());
+            continue;
+        }
+        add(entry);
+        imported++;
+    }
+    return imported;
+}
+
+QString ProfileLibrary::gearing(const Profile &profile)
+{
+    QStringList ratios;
+    for(int a = 0; a < 2; a++)
+    {
+        //motor turns per axis turn
+        qint64 num = (qint64)profile.axis[a].worm * profile.axis[a].crown;
+        qint64 den = qMax(1, profile.axis[a].motor);
+        qint64 d = qMax((qint64)1, gcd(num, den));
+        ratios.append(QString::number(num / d) + "/" + QString::number(den / d));
+    }
+    return ratios.join(":");
+}
+
+void ProfileLibrary::reindex()
+{
+    byName.clear();
+    byMountType.clear();
+    byAddress.clear();
+    byFirmware.clear();
+    byDevice.clear();
+    byGearing.clear();
+    for(int i = 0; i < entries.count(); i++)
+        index(i);
+}
+
+void ProfileLibrary::index(int i)
+{
+    const Entry &entry = entries[i];
+    byName.insert(entry.name, i);
+    byMountType.insert(entry.profile.mount_type, i);
+    byAddress.insert(entry.profile.address, i);
+    byFirmware.insert(entry.firmware, i);
+    if(!entry.device.isEmpty())
+        byDevice.insert(entry.device, i);
+    byGearing.insert(gearing(entry.profile), i);
+}
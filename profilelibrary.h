@@ -0,0 +1,89 @@
+#ifndef PROFILELIBRARY_H
+#define PROFILELIBRARY_H
+
+#include <QHash>
+#include <QList>
+#include <QMultiHash>
+#include <QString>
+#include <QStringList>
+#include "profile.h"
+
+///All the profiles of a fleet in one file, each one tagged with the
+///controller it was made for. The file is read once into memory and
+///indexed by mount type, gearing, bus address, firmware version and
+///device, queries never touch the disk.
+class ProfileLibrary
+{
+    public:
+        struct Entry
+        {
+            QString name;
+            ///DeviceCache::deviceKey() of the controller, empty if made for any
+            QString device;
+            ///firmware version, -1 if made for any
+            int firmware { -1 };
+            Profile profile;
+        };
+        ///Fields left at their defaults match anything
+        struct Query
+        {
+            ///index in mounttypes
+            int mountType { -1 };
+            int address { -1 };
+            int firmware { -1 };
+            QString device;
+            ///as returned by gearing()
+            QString gearing;
+        };
+
+        ProfileLibrary(QString filename);
+
+        QString fileName() const
+        {
+            return filename;
+        }
+        ///Read the library, false if it exists but cannot be read
+        bool open();
+        ///Write the library, never leaves a partial file
+        bool save();
+        int count() const
+        {
+            return entries.count();
+        }
+        Entry entry(int index) const
+        {
+            return entries.value(index);
+        }
+        ///Index of the entry called name, -1 if none
+        int indexOf(QString name) const
+        {
+            return byName.value(name, -1);
+        }
+        QStringList names() const;
+        ///Add entry, replacing the one with the same name, returns its index
+        int add(const Entry &entry);
+        bool remove(QString name);
+        ///Entries matching every field set in query, in library order
+        QList<int> find(const Query &query) const;
+        ///Entries sharing anything with the controller, best first: same device, firmware, address, mount type
+        QList<int> match(QString device, int firmware, int address, int mountType) const;
+        ///Add the INI and binary profiles in dir, named after the files, returns how many
+        int importDirectory(QString dir, QStringList *failed = nullptr);
+
+        ///Reduced gear ratio of both axes, profiles with the same one turn the mount alike
+        static QString gearing(const Profile &profile);
+
+    private:
+        void reindex();
+        void index(int i);
+        QString filename;
+        QList<Entry> entries;
+        QHash<QString, int> byName;
+        QMultiHash<int, int> byMountType;
+        QMultiHash<int, int> byAddress;
+        QMultiHash<int, int> byFirmware;
+        QMultiHash<QString, int> byDevice;
+        QMultiHash<QString, int> byGearing;
+};
+
+#endif // PROFILELIBRARY_H
@@ -0,0 +1,101 @@
+#include "profiletransaction.h"
+#include "parameters.h"
+
+ProfileTransaction::ProfileTransaction(const Profile &c)
+{
+    current = c;
+    next = c;
+}
+
+void ProfileTransaction::stage(const Profile &profile)
+{
+    next = profile;
+    keys = current.diff(next);
+}
+
+QStringList ProfileTransaction::validate() const
+{
+    QStringList invalid;
+    for(int a = 0; a < 2; a++)
+    {
+        for(int i = 0; i < AXIS_PARAMETERS; i++)
+        {
+            int value = next.axis[a].*axisParameters[i].field;
+            if(value < axisParameters[i].minimum || value > axisParameters[i].maximum)
+                invalid.append(axisParameterKey(i, a));
+        }
+    }
+    //same ranges as the window controls
+    if(next.mount_type < 0 || next.mount_type >= mounttypes.count())
+        invalid.append("MountType");
+    if(next.address < 0 || next.address > 127)
+        invalid.append("Address");
+    if(next.pwm_frequency < 0 || next.pwm_frequency > 15)
+        invalid.append("PWMFreq");
+    if(next.mount_style < 0 || next.mount_style > 2)
+        invalid.append("MountStyle");
+    return invalid;
+}
+
+bool ProfileTransaction::commit(SettingsStore *settings)
+{
+    if(!validate().isEmpty())
+        return false;
+    counters = Stats();
+    counters.changed = keys.count();
+    bool mount[MOUNT_PARAMETERS] = { };
+    int first[2] = { AXIS_PARAMETERS, AXIS_PARAMETERS };
+    int keyByKey = 0;
+    int writes = 0;
+    for(QString key : keys)
+    {
+        //every control handler saves the whole profile, the notes are saved with the next one
+        writes += (key != "Notes");
+        int separator = key.lastIndexOf('_');
+        int parameter = separator < 0 ? -1 : axisParameterIndex(key.left(separator).toUtf8().constData());
+        if(parameter >= 0)
+        {
+            //an axis control pushes its own value only
+            int a = key.mid(separator + 1).toInt();
+            first[a] = qMin(first[a], parameter);
+            keyByKey += (axisParameters[parameter].set != nullptr);
+            continue;
+        }
+        parameter = mountParameterIndex(key.toUtf8().constData());
+        if(parameter >= 0)
+            mount[parameter] = true;
+    }
+    //the half current features go with the mount style
+    if(next.half_current != current.half_current)
+        mount[mountParameterIndex("MountStyle")] = true;
+    int calls = 0;
+    for(int i = 0; i < MOUNT_PARAMETERS; i++)
+    {
+        if(mount[i])
+        {
+            int made = mountParameters[i].apply(next);
+            //a mount-wide control makes the same calls
+            keyByKey += made;
+            calls += made;
+            //the axes are pushed again after mount-wide changes, as Profile::apply() does
+            first[0] = first[1] = 0;
+        }
+    }
+    //the library derives the later parameters of the table from the earlier ones, push them all from the first change on
+    for(int a = 0; a < 2; a++)
+        calls += next.applyAxis(a, first[a]);
+    counters.setterCalls = calls;
+    counters.setterCallsAvoided = keyByKey - calls;
+    next.save(settings);
+    settings->scheduleCommit();
+    counters.writesAvoided = qMax(0, writes - 1);
+    current = next;
+    keys.clear();
+    return true;
+}
+
+QString ProfileTransaction::Stats::text() const
+{
+    return QString("%1 keys changed, %2 library calls (%3 key by key), %4 settings writes avoided")
+           .arg(changed).arg(setterCalls).arg(setterCalls + setterCallsAvoided).arg(writesAvoided);
+}
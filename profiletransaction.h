@@ -0,0 +1,58 @@
+#ifndef PROFILETRANSACTION_H
+#define PROFILETRANSACTION_H
+
+#include <QString>
+#include <QStringList>
+#include "profile.h"
+#include "settingsstore.h"
+
+///Applies a profile in one pass. The profile is staged against the one in
+///effect and validated as a whole, then the commit pushes what changed to the
+///library and stores it once: nothing is applied if any value is out of range, and
+///no half-applied state is ever saved.
+class ProfileTransaction
+{
+    public:
+        struct Stats
+        {
+            ///keys whose value differs from the profile in effect
+            int changed { 0 };
+            ///library calls made by the commit
+            int setterCalls { 0 };
+            ///library calls the control handlers would have made one key at a time, less setterCalls,
+            ///negative when the commit pushes more than the changed keys
+            int setterCallsAvoided { 0 };
+            ///settings writes the control handlers would have made, less the one of the commit
+            int writesAvoided { 0 };
+            QString text() const;
+        };
+
+        ProfileTransaction(const Profile &current);
+
+        void stage(const Profile &profile);
+        const Profile &staged() const
+        {
+            return next;
+        }
+        ///Keys that differ between the profile in effect and the staged one
+        QStringList changed() const
+        {
+            return keys;
+        }
+        ///Keys of the staged profile out of range, empty if it can be committed
+        QStringList validate() const;
+        ///Push the staged profile to the library and store it in settings, false if it does not validate
+        bool commit(SettingsStore *settings);
+        Stats stats() const
+        {
+            return counters;
+        }
+
+    private:
+        Profile current;
+        Profile next;
+        QStringList keys;
+        Stats counters;
+};
+
+#endif // PROFILETRANSACTION_H
@@ -0,0 +1,168 @@
+#include "settingsstore.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSettings>
+#include <QTemporaryFile>
+#include <QMutexLocker>
+
+SettingsStore::SettingsStore(QString name, int window_ms, QObject *parent) : QObject(parent)
+{
+    filename = name;
+    timer.setSingleShot(true);
+    timer.setInterval(window_ms);
+    connect(&timer, &QTimer::timeout, this, [ = ] ()
+    {
+        commit();
+    });
+    load();
+}
+
+SettingsStore::~SettingsStore()
+{
+    commit();
+}
+
+void SettingsStore::load()
+{
+    QSettings s(filename, QSettings::Format::IniFormat);
+    for(QString key : s.allKeys())
+        values.insert(key, s.value(key));
+    lastSize = QFileInfo(filename).size();
+}
+
+QVariant SettingsStore::value(const QString &key, const QVariant &defaultValue)
+{
+    QMutexLocker locker(&mutex);
+    return values.value(key, defaultValue);
+}
+
+bool SettingsStore::contains(const QString &key)
+{
+    QMutexLocker locker(&mutex);
+    return values.contains(key);
+}
+
+void SettingsStore::setValue(const QString &key, const QVariant &value)
+{
+    QMutexLocker locker(&mutex);
+    counters.updates++;
+    //values read back from the file are strings, compare the serialized form
+    if(values.contains(key) && values[key].toString() == value.toString() && values[key].isNull() == value.isNull())
+    {
+        counters.unchanged++;
+        return;
+    }
+    values.insert(key, value);
+    dirty.insert(key);
+}
+
+void SettingsStore::remove(const QString &key)
+{
+    QMutexLocker locker(&mutex);
+    if(values.remove(key) > 0)
+        dirty.insert(key);
+}
+
+bool SettingsStore::isDirty()
+{
+    QMutexLocker locker(&mutex);
+    return !dirty.isEmpty();
+}
+
+void SettingsStore::setCommitWindow(int window_ms)
+{
+    QMetaObject::invokeMethod(this, [ = ] ()
+    {
+        timer.setInterval(window_ms);
+    }, Qt::QueuedConnection);
+}
+
+void SettingsStore::scheduleCommit()
+{
+    QMutexLocker locker(&mutex);
+    counters.requests++;
+    if(dirty.isEmpty() || pending)
+    {
+        counters.commitsAvoided++;
+        counters.bytesAvoided += lastSize;
+        return;
+    }
+    pending = true;
+    QMetaObject::invokeMethod(this, [ = ] ()
+    {
+        timer.start();
+    }, Qt::QueuedConnection);
+}
+
+bool SettingsStore::commit()
+{
+    QMap<QString, QVariant> image;
+    {
+        QMutexLocker locker(&mutex);
+        pending = false;
+        if(dirty.isEmpty())
+            return true;
+        image = values;
+        dirty.clear();
+    }
+    //QSettings does the serializing into a scratch file next to the profile,
+    //QSaveFile then puts those bytes in place with a single rename
+    QFileInfo info(filename);
+    QTemporaryFile scratch(info.absolutePath() + "/." + info.fileName() + ".XXXXXX");
+    bool ok = scratch.open();
+    QByteArray data;
+    if(ok)
+    {
+        scratch.close();
+        {
+            QSettings ini(scratch.fileName(), QSettings::Format::IniFormat);
+            for(auto it = image.constBegin(); it != image.constEnd(); ++it)
+                ini.setValue(it.key(), it.value());
+            ini.sync();
+            ok = (ini.status() == QSettings::NoError);
+        }
+        ok = ok && scratch.open();
+        if(ok)
+            data = scratch.readAll();
+    }
+    if(ok)
+    {
+        QSaveFile out(filename);
+        ok = out.open(QIODevice::WriteOnly);
+        if(ok)
+            ok = (out.write(data) == data.length());
+        if(ok)
+            ok = out.commit();
+        else
+            out.cancelWriting();
+    }
+    QMutexLocker locker(&mutex);
+    if(!ok)
+    {
+        //the whole image is retried when the window runs out again
+        for(auto it = image.constBegin(); it != image.constEnd(); ++it)
+            dirty.insert(it.key());
+        if(!pending)
+        {
+            pending = true;
+            QMetaObject::invokeMethod(this, [ = ] ()
+            {
+                timer.start();
+            }, Qt::QueuedConnection);
+        }
+        return false;
+    }
+    counters.commits++;
+    counters.bytesWritten += data.length();
+    lastSize = data.length();
+    locker.unlock();
+    emit committed();
+    return true;
+}
+
+SettingsStore::Stats SettingsStore::stats()
+{
+    QMutexLocker locker(&mutex);
+    return counters;
+}
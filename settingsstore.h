@@ -0,0 +1,73 @@
+#ifndef SETTINGSSTORE_H
+#define SETTINGSSTORE_H
+
+#include <QObject>
+#include <QString>
+#include <QVariant>
+#include <QMap>
+#include <QSet>
+#include <QMutex>
+#include <QTimer>
+
+///In-memory view of an INI profile with write-behind persistence.
+///Changed keys are marked dirty and commits are coalesced over a window.
+///A commit lets QSettings write the image to a scratch file, whose bytes
+///QSaveFile then renames over the profile, so an interrupted write never leaves a
+///truncated settings file behind. A failed commit is retried after the window.
+class SettingsStore : public QObject
+{
+        Q_OBJECT
+    public:
+        struct Stats
+        {
+            ///setValue() calls
+            quint64 updates { 0 };
+            ///setValue() calls that did not change anything
+            quint64 unchanged { 0 };
+            ///commits requested by the callers
+            quint64 requests { 0 };
+            ///commits that hit the storage
+            quint64 commits { 0 };
+            quint64 bytesWritten { 0 };
+            ///requests absorbed by dirty tracking and coalescing
+            quint64 commitsAvoided { 0 };
+            ///what the absorbed requests would have written
+            quint64 bytesAvoided { 0 };
+        };
+
+        SettingsStore(QString filename, int window_ms = 1000, QObject *parent = nullptr);
+        ~SettingsStore();
+
+        QString fileName() const
+        {
+            return filename;
+        }
+        QVariant value(const QString &key, const QVariant &defaultValue = QVariant());
+        bool contains(const QString &key);
+        void setValue(const QString &key, const QVariant &value);
+        void remove(const QString &key);
+        bool isDirty();
+        ///Ask for the dirty keys to be written within the commit window
+        void scheduleCommit();
+        ///Write now if anything is dirty, returns false on I/O errors
+        bool commit();
+        void setCommitWindow(int window_ms);
+        Stats stats();
+
+    signals:
+        void committed();
+
+    private:
+        void load();
+
+        QString filename;
+        QMap<QString, QVariant> values;
+        QSet<QString> dirty;
+        QMutex mutex;
+        QTimer timer;
+        bool pending { false };
+        quint64 lastSize { 0 };
+        Stats counters;
+};
+
+#endif // SETTINGSSTORE_H
@@ -0,0 +1,443 @@
+#include "simulator.h"
+#include <cmath>
+#include <cctype>
+#include <memory>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocale>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QUdpSocket>
+#include <QUrl>
+#include <QUrlQuery>
+#include <QSocketNotifier>
+#include <QTimer>
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+static const double SIMULATOR_SIDEREAL_DAY = 86164.0916000;
+static const quint32 POSITION_OFFSET = 0x800000;
+
+///Little-endian hex bytes, as the protocol carries 8, 16 and 24 bit values
+static QByteArray encode(quint32 value, int bytes)
+{
+    QByteArray out;
+    for(int b = 0; b < bytes; b++)
+        out.append(QByteArray::number((value >> (8 * b)) & 0xff, 16).rightJustified(2, '0').toUpper());
+    return out;
+}
+
+static quint32 decode(QByteArray data)
+{
+    quint32 value = 0;
+    for(int b = 0; b + 1 < data.length() && b < 8; b += 2)
+        value |= data.mid(b, 2).toUInt(nullptr, 16) << (4 * b);
+    return value;
+}
+
+Simulator::Simulator(SimulatorConfig c, QObject *parent) : QObject(parent)
+{
+    config = c;
+    random.seed(config.seed);
+    for(int a = 0; a < 2; a++)
+        axes[a].period = (quint32)(config.timerFrequency * SIMULATOR_SIDEREAL_DAY / config.cpr);
+    clock.start();
+    QTimer *timer = new QTimer(this);
+    connect(timer, &QTimer::timeout, this, [ = ] ()
+    {
+        advance();
+    });
+    timer->start(20);
+}
+
+Simulator::~Simulator()
+{
+#ifdef Q_OS_UNIX
+    if(ptyFd >= 0)
+        close(ptyFd);
+#endif
+}
+
+double Simulator::maxRate() const
+{
+    return config.maxSpeed * config.cpr / SIMULATOR_SIDEREAL_DAY;
+}
+
+double Simulator::acceleration() const
+{
+    return config.acceleration * config.cpr / 360.0;
+}
+
+double Simulator::slewRate(const SimulatedAxis &axis) const
+{
+    if(axis.period == 0)
+        return maxRate();
+    double rate = (double)config.timerFrequency / axis.period * (axis.fast ? config.highSpeedRatio : 1);
+    return fmin(rate, maxRate());
+}
+
+double Simulator::readPosition(const SimulatedAxis &axis) const
+{
+    double wormsteps = (double)config.cpr / config.wormTeeth;
+    double amplitude = config.periodicError * config.cpr / 1296000.0;
+    return axis.position + amplitude * sin(2.0 * M_PI * axis.position / wormsteps);
+}
+
+void Simulator::advance()
+{
+    qint64 now = clock.nsecsElapsed();
+    double dt = (now - last_ns) / 1000000000.0;
+    last_ns = now;
+    for(int a = 0; a < 2; a++)
+        advance(axes[a], dt);
+}
+
+void Simulator::advance(SimulatedAxis &axis, double dt)
+{
+    double acc = acceleration();
+    while(dt > 0.0 && axis.running)
+    {
+        double h = fmin(dt, 0.01);
+        dt -= h;
+        double desired = 0.0;
+        double remaining = axis.target - axis.position;
+        if(!axis.stopping)
+        {
+            if(axis.tracking)
+                desired = (axis.ccw ? -1.0 : 1.0) * slewRate(axis);
+            else
+                desired = (remaining < 0 ? -1.0 : 1.0) * fmin(axis.fast ? maxRate() : slewRate(axis), sqrt(2.0 * acc * fabs(remaining)));
+        }
+        double dv = desired - axis.velocity;
+        axis.velocity += fmax(-acc * h, fmin(acc * h, dv));
+        if(!axis.tracking && !axis.stopping && fabs(remaining) <= fabs(axis.velocity) * h + 0.5)
+        {
+            axis.position = axis.target;
+            axis.velocity = 0.0;
+            axis.running = false;
+            break;
+        }
+        axis.position += axis.velocity * h;
+        if(axis.stopping && axis.velocity == 0.0)
+        {
+            axis.running = false;
+            axis.stopping = false;
+        }
+    }
+    if(!axis.running)
+        axis.velocity = 0.0;
+}
+
+QByteArray Simulator::axisCommand(char cmd, int a, QByteArray data)
+{
+    SimulatedAxis &axis = axes[a];
+    switch(cmd)
+    {
+        case 'e':
+            return encode(config.version, 3);
+        case 'a':
+            return encode(config.cpr, 3);
+        case 'b':
+            return encode(config.timerFrequency, 3);
+        case 'g':
+            return encode(config.highSpeedRatio, 1);
+        case 's':
+            return encode(config.cpr / config.wormTeeth, 3);
+        case 'D':
+            return encode((quint32)(config.timerFrequency * SIMULATOR_SIDEREAL_DAY / config.cpr), 3);
+        case 'f':
+        {
+            int mode = (axis.tracking ? 1 : 0) | (axis.ccw ? 2 : 0) | (axis.fast ? 4 : 0);
+            return QByteArray::number(mode, 16).toUpper() + (axis.running ? "1" : "0") + "1";
+        }
+        case 'j':
+            return encode((quint32)((qint64)round(readPosition(axis)) + POSITION_OFFSET) & 0xffffff, 3);
+        case 'h':
+            return encode((quint32)(axis.target + POSITION_OFFSET) & 0xffffff, 3);
+        case 'i':
+            return encode(axis.period, 3);
+        case 'E':
+            axis.position = (qint64)decode(data) - POSITION_OFFSET;
+            return "";
+        case 'F':
+            return "";
+        case 'G':
+        {
+            if(axis.running && !axis.stopping)
+                return "!2";
+            int mode = QByteArray(1, data.at(0)).toInt(nullptr, 16);
+            int direction = QByteArray(1, data.at(1)).toInt(nullptr, 16);
+            axis.tracking = (mode & 1) != 0;
+            axis.fast = (mode == 0 || mode == 3);
+            axis.ccw = (direction & 1) != 0;
+            return "";
+        }
+        case 'H':
+            axis.increment = decode(data);
+            axis.target = (qint64)round(axis.position) + (axis.ccw ? -axis.increment : axis.increment);
+            return "";
+        case 'S':
+            axis.target = (qint64)decode(data) - POSITION_OFFSET;
+            return "";
+        case 'M':
+            axis.brake = decode(data);
+            return "";
+        case 'I':
+            axis.period = decode(data);
+            return "";
+        case 'J':
+            axis.running = true;
+            axis.stopping = false;
+            return "";
+        case 'K':
+            axis.stopping = axis.running;
+            return "";
+        case 'L':
+            axis.running = false;
+            axis.stopping = false;
+            axis.velocity = 0.0;
+            return "";
+        default:
+            break;
+    }
+    //configuration extensions: an uppercase command stores, its lowercase reads back
+    QByteArray key = QByteArray(1, (char)tolower(cmd)) + QByteArray::number(a + 1);
+    if(isupper(cmd))
+    {
+        registers.insert(key, data);
+        return "";
+    }
+    return registers.value(key + data, registers.value(key, "000000"));
+}
+
+QByteArray Simulator::handle(QByteArray command)
+{
+    if(command.length() < 2)
+        return "!1";
+    char cmd = command.at(0);
+    char axis = command.at(1);
+    QByteArray data = command.mid(2);
+    if(axis < '1' || axis > '3')
+        return "!3";
+    if(cmd == 'G' && data.length() < 2)
+        return "!1";
+    advance();
+    QByteArray reply;
+    for(int a = 0; a < 2; a++)
+    {
+        if(axis - '1' != a && axis != '3')
+            continue;
+        reply = axisCommand(cmd, a, data);
+        if(reply.startsWith('!'))
+            return reply;
+    }
+    return "=" + reply;
+}
+
+int Simulator::transit(int bytes) const
+{
+    int ms = config.latency_ms;
+    if(config.bandwidth > 0)
+        ms += bytes * 1000 / config.bandwidth;
+    return ms;
+}
+
+bool Simulator::lose()
+{
+    if(config.loss <= 0.0)
+        return false;
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    return uniform(random) < config.loss;
+}
+
+void Simulator::receive(QByteArray data, std::function<void(QByteArray)> send)
+{
+    counters.bytesIn += data.length();
+    for(QByteArray request : data.split('\r'))
+    {
+        if(!request.startsWith(':'))
+            continue;
+        counters.requests++;
+        if(lose())
+        {
+            counters.dropped++;
+            continue;
+        }
+        //the request is served when it arrives, the reply travels back over the same link
+        QTimer::singleShot(transit(request.length() + 1), this, [ = ] ()
+        {
+            QByteArray reply = handle(request.mid(1)) + "\r";
+            QTimer::singleShot(transit(reply.length()), this, [ = ] ()
+            {
+                counters.bytesOut += reply.length();
+                send(reply);
+            });
+        });
+    }
+}
+
+bool Simulator::listenUdp(quint16 port)
+{
+    udp = new QUdpSocket(this);
+    if(!udp->bind(QHostAddress::Any, port))
+        return false;
+    connect(udp, &QUdpSocket::readyRead, this, [ = ] ()
+    {
+        while(udp->hasPendingDatagrams())
+        {
+            QByteArray datagram;
+            datagram.resize(udp->pendingDatagramSize());
+            QHostAddress sender;
+            quint16 senderPort;
+            udp->readDatagram(datagram.data(), datagram.size(), &sender, &senderPort);
+            receive(datagram, [ = ] (QByteArray reply)
+            {
+                udp->writeDatagram(reply, sender, senderPort);
+            });
+        }
+    });
+    return true;
+}
+
+QString Simulator::openPty()
+{
+#ifdef Q_OS_UNIX
+    ptyFd = posix_openpt(O_RDWR | O_NOCTTY);
+    if(ptyFd < 0)
+        return QString();
+    if(grantpt(ptyFd) || unlockpt(ptyFd))
+    {
+        close(ptyFd);
+        ptyFd = -1;
+        return QString();
+    }
+    struct termios tio;
+    tcgetattr(ptyFd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(ptyFd, TCSANOW, &tio);
+    ptyNotifier = new QSocketNotifier(ptyFd, QSocketNotifier::Read, this);
+    connect(ptyNotifier, &QSocketNotifier::activated, this, [ = ] ()
+    {
+        char buf[256];
+        ssize_t n = read(ptyFd, buf, sizeof(buf));
+        if(n <= 0)
+            return;
+        ptyBuffer.append(buf, n);
+        int end = ptyBuffer.lastIndexOf('\r');
+        if(end < 0)
+            return;
+        QByteArray complete = ptyBuffer.left(end + 1);
+        ptyBuffer.remove(0, end + 1);
+        receive(complete, [ = ] (QByteArray reply)
+        {
+            if(write(ptyFd, reply.constData(), reply.length()) < 0)
+                counters.dropped++;
+        });
+    });
+    return QString(ptsname(ptyFd));
+#else
+    return QString();
+#endif
+}
+
+FirmwareServer::FirmwareServer(QString directory, QObject *parent) : QObject(parent)
+{
+    dir = directory;
+}
+
+bool FirmwareServer::listen(quint16 port)
+{
+    server = new QTcpServer(this);
+    if(!server->listen(QHostAddress::Any, port))
+        return false;
+    connect(server, &QTcpServer::newConnection, this, [ = ] ()
+    {
+        while(server->hasPendingConnections())
+        {
+            QTcpSocket *socket = server->nextPendingConnection();
+            counters.connections++;
+            connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+            std::shared_ptr<QByteArray> buffer(new QByteArray());
+            //requests are answered in order and the connection stays open
+            connect(socket, &QTcpSocket::readyRead, this, [ = ] ()
+            {
+                buffer->append(socket->readAll());
+                int end;
+                while((end = buffer->indexOf("\r\n\r\n")) >= 0)
+                {
+                    QList<QByteArray> lines = buffer->left(end).split('\n');
+                    buffer->remove(0, end + 4);
+                    QList<QByteArray> request = lines.takeFirst().trimmed().split(' ');
+                    QMap<QByteArray, QByteArray> headers;
+                    for(QByteArray line : lines)
+                    {
+                        int colon = line.indexOf(':');
+                        if(colon > 0)
+                            headers.insert(line.left(colon).trimmed().toLower(), line.mid(colon + 1).trimmed());
+                    }
+                    QByteArray reply = "HTTP/1.1 405 Method Not Allowed\r\nContent-Length: 0\r\n\r\n";
+                    if(request.count() >= 2 && request[0] == "GET")
+                        reply = answer(request[1], headers);
+                    counters.requests++;
+                    counters.bytesOut += reply.length();
+                    socket->write(reply);
+                    if(headers.value("connection").toLower() == "close")
+                        socket->disconnectFromHost();
+                }
+            });
+        }
+    });
+    return true;
+}
+
+QByteArray FirmwareServer::answer(QByteArray target, QMap<QByteArray, QByteArray> headers)
+{
+    QUrlQuery query(QUrl::fromEncoded(target));
+    QString product = query.queryItemValue("product");
+    QByteArray body;
+    QDateTime modified;
+    if(query.queryItemValue("download") == "yes")
+    {
+        QFileInfo info(dir + "/" + product + ".json");
+        QFile file(info.filePath());
+        if(product.contains('/') || !file.open(QIODevice::ReadOnly))
+            return "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+        body = file.readAll();
+        modified = info.lastModified();
+    }
+    else
+    {
+        //same layout as firmware.php: base64 of a JSON array of firmware/<product>-firmware.bin
+        QStringList names;
+        for(QFileInfo info : QDir(dir).entryInfoList(QStringList() << (product.isEmpty() ? "*" : product) + ".json", QDir::Files, QDir::Name))
+        {
+            names.append("firmware/" + info.completeBaseName() + "-firmware.bin");
+            if(!modified.isValid() || info.lastModified() > modified)
+                modified = info.lastModified();
+        }
+        QJsonObject obj;
+        obj["data"] = QString(QJsonDocument::fromVariant(names).toJson(QJsonDocument::Compact).toBase64());
+        body = QJsonDocument(obj).toJson(QJsonDocument::Compact);
+    }
+    QByteArray etag = "\"" + QCryptographicHash::hash(body, QCryptographicHash::Md5).toHex() + "\"";
+    QByteArray lastModified = QLocale::c().toString(modified.toUTC(), "ddd, dd MMM yyyy hh:mm:ss").toLatin1() + " GMT";
+    QByteArray validators = "ETag: " + etag + "\r\nLast-Modified: " + lastModified + "\r\n";
+    bool fresh = headers.contains("if-none-match") ? headers.value("if-none-match") == etag :
+                 headers.value("if-modified-since") == lastModified;
+    if(fresh)
+    {
+        counters.notModified++;
+        return "HTTP/1.1 304 Not Modified\r\n" + validators + "\r\n";
+    }
+    return "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n" + validators +
+           "Content-Length: " + QByteArray::number(body.length()) + "\r\n\r\n" + body;
+}
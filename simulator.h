@@ -0,0 +1,146 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <QObject>
+#include <QMap>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <random>
+#include <functional>
+
+class QUdpSocket;
+class QSocketNotifier;
+class QTcpServer;
+
+///Motion model of one simulated axis, positions in microsteps
+struct SimulatedAxis
+{
+    double position { 0.0 };
+    double velocity { 0.0 };
+    ///slew when true, goto otherwise
+    bool tracking { true };
+    bool ccw { false };
+    bool fast { false };
+    bool running { false };
+    bool stopping { false };
+    quint32 period { 1 };
+    qint64 target { 0 };
+    qint64 increment { 0 };
+    quint32 brake { 3500 };
+};
+
+///Mount and link parameters of the simulator
+struct SimulatorConfig
+{
+    ///microsteps per axis revolution
+    quint32 cpr { 9024000 };
+    quint32 timerFrequency { 64935 };
+    quint32 highSpeedRatio { 16 };
+    int wormTeeth { 180 };
+    ///acceleration in degrees per second squared
+    double acceleration { 2.0 };
+    ///maximum speed as a multiple of sidereal
+    double maxSpeed { 800.0 };
+    ///worm periodic error amplitude, arcseconds
+    double periodicError { 0.0 };
+    ///firmware version answered to :e
+    quint32 version { 0x000337 };
+    ///one-way link latency, ms
+    int latency_ms { 0 };
+    ///link bandwidth in bytes per second, 0 for unlimited
+    int bandwidth { 0 };
+    ///probability of losing a request
+    double loss { 0.0 };
+    quint32 seed { 1 };
+};
+
+///GT controller speaking the SkyWatcher motor protocol. Standard commands drive
+///the motion model, the AHP configuration extensions and any other command are
+///kept as generic per-axis registers so that writes read back unchanged.
+class Simulator : public QObject
+{
+        Q_OBJECT
+    public:
+        Simulator(SimulatorConfig config, QObject *parent = nullptr);
+        ~Simulator();
+
+        bool listenUdp(quint16 port);
+        ///Open a pseudo terminal, returns the slave device name or an empty string
+        QString openPty();
+        ///Answer a single command, without the leading ':' and the trailing '\r'
+        QByteArray handle(QByteArray command);
+        ///Advance both axes to the current time
+        void advance();
+
+        struct Stats
+        {
+            quint64 requests { 0 };
+            quint64 dropped { 0 };
+            quint64 bytesIn { 0 };
+            quint64 bytesOut { 0 };
+        };
+        Stats stats() const
+        {
+            return counters;
+        }
+
+    private:
+        QByteArray axisCommand(char cmd, int axis, QByteArray data);
+        void advance(SimulatedAxis &axis, double dt);
+        double slewRate(const SimulatedAxis &axis) const;
+        double maxRate() const;
+        double acceleration() const;
+        ///Position read back by the controller, periodic error included
+        double readPosition(const SimulatedAxis &axis) const;
+        ///Milliseconds the link takes to carry bytes
+        int transit(int bytes) const;
+        bool lose();
+        void receive(QByteArray data, std::function<void(QByteArray)> send);
+
+        SimulatorConfig config;
+        SimulatedAxis axes[2];
+        QMap<QByteArray, QByteArray> registers;
+        QElapsedTimer clock;
+        qint64 last_ns { 0 };
+        std::mt19937 random;
+        QUdpSocket *udp { nullptr };
+        int ptyFd { -1 };
+        QSocketNotifier *ptyNotifier { nullptr };
+        QByteArray ptyBuffer;
+        Stats counters;
+};
+
+///Stand-in for the firmware.php catalog, serving the JSON documents of a
+///directory (the format of the bundled firmware) over HTTP/1.1 with keep-alive
+///and ETag/Last-Modified validation
+class FirmwareServer : public QObject
+{
+        Q_OBJECT
+    public:
+        struct Stats
+        {
+            quint64 connections { 0 };
+            quint64 requests { 0 };
+            quint64 notModified { 0 };
+            quint64 bytesOut { 0 };
+        };
+
+        FirmwareServer(QString directory, QObject *parent = nullptr);
+
+        bool listen(quint16 port);
+        Stats stats() const
+        {
+            return counters;
+        }
+
+    private:
+        ///Status line, headers and body answering a GET of target
+        QByteArray answer(QByteArray target, QMap<QByteArray, QByteArray> headers);
+
+        QString dir;
+        QTcpServer *server { nullptr };
+        Stats counters;
+};
+
+#endif // SIMULATOR_H
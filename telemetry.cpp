@@ -0,0 +1,88 @@
+#include "telemetry.h"
+#include <cmath>
+#include <cstring>
+#include <QDateTime>
+
+TelemetrySampler::TelemetrySampler()
+{
+    published.store(0);
+    versions[0].store(0);
+    versions[1].store(0);
+    memset(buffers, 0, sizeof(buffers));
+    for(int a = 0; a < 2; a++)
+    {
+        estimatorType[a].store(EstimatorMovingAverage);
+        estimatorWindow[a].store(1);
+    }
+    resetRequested.store(true);
+}
+
+void TelemetrySampler::reset()
+{
+    resetRequested.store(true);
+}
+
+void TelemetrySampler::setEstimator(int axis, EstimatorType type, int window)
+{
+    estimatorType[axis].store(type);
+    estimatorWindow[axis].store(window);
+}
+
+void TelemetrySampler::sample()
+{
+    TelemetrySnapshot next;
+    memset(&next, 0, sizeof(next));
+    next.sampled_ms = QDateTime::currentMSecsSinceEpoch();
+    for(int a = 0; a < 2; a++)
+    {
+        next.axis[a].steps = ahp_gt_get_position(a, &next.axis[a].timestamp) * ahp_gt_get_totalsteps(a) / M_PI / 2.0;
+        next.axis[a].status = ahp_gt_get_status(a);
+    }
+    bool restart = resetRequested.exchange(false);
+    for(int a = 0; a < 2; a++)
+    {
+        VelocityEstimator &estimator = estimators[a];
+        if(restart)
+            estimator.reset();
+        estimator.setType((EstimatorType)estimatorType[a].load());
+        estimator.setWindow(estimatorWindow[a].load());
+        double degrees_per_step = 360.0 / ahp_gt_get_totalsteps(a);
+        //quantization noise of the position counter
+        estimator.setKalmanNoise(1e-9, degrees_per_step * degrees_per_step / 12.0);
+        VelocityEstimate estimate = estimator.update(next.axis[a].timestamp, next.axis[a].steps * degrees_per_step);
+        next.axis[a].speed = estimate.rate;
+        next.axis[a].speed_variance = estimate.variance;
+    }
+    publish(next);
+}
+
+void TelemetrySampler::publish(const TelemetrySnapshot &next)
+{
+    //readers copy buffers[published & 1], write into the other slot
+    quint64 seq = published.load(std::memory_order_relaxed) + 1;
+    int slot = seq & 1;
+    quint64 version = versions[slot].load(std::memory_order_relaxed);
+    versions[slot].store(version + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    buffers[slot] = next;
+    buffers[slot].sequence = seq;
+    versions[slot].store(version + 2, std::memory_order_release);
+    published.store(seq, std::memory_order_release);
+}
+
+TelemetrySnapshot TelemetrySampler::snapshot() const
+{
+    TelemetrySnapshot copy;
+    while(true)
+    {
+        int slot = published.load(std::memory_order_acquire) & 1;
+        quint64 before = versions[slot].load(std::memory_order_acquire);
+        if(before & 1)
+            continue;
+        copy = buffers[slot];
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(versions[slot].load(std::memory_order_relaxed) == before)
+            break;
+    }
+    return copy;
+}
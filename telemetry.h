@@ -0,0 +1,66 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <atomic>
+#include <QtGlobal>
+#include <ahp_gt.h>
+#include "estimator.h"
+
+struct AxisTelemetry
+{
+    ///Position in motor steps
+    double steps;
+    ///Controller timestamp of the position reading, seconds
+    double timestamp;
+    ///Estimated rate in degrees per second
+    double speed;
+    ///Variance of the estimated rate
+    double speed_variance;
+    SkywatcherAxisStatus status;
+};
+
+///Immutable two-axis sample, both axes are read back to back within the same tick
+struct TelemetrySnapshot
+{
+    quint64 sequence;
+    qint64 sampled_ms;
+    AxisTelemetry axis[2];
+};
+
+///Samples both axes in a single link window and publishes the result through a
+///double buffer where each slot is guarded by its own sequence counter: the sampler
+///never waits and readers never lock, they only retry if the slot they are copying
+///gets recycled under them, which needs two publications in the meantime.
+class TelemetrySampler
+{
+    public:
+        TelemetrySampler();
+
+        ///Read position and status of both axes and publish a new snapshot.
+        ///Only one thread may call sample()
+        void sample();
+        ///Copy the latest published snapshot, lock-free
+        TelemetrySnapshot snapshot() const;
+        quint64 sequence() const
+        {
+            return published.load(std::memory_order_acquire);
+        }
+        ///Configure the velocity estimator of axis, applied on the next sample
+        void setEstimator(int axis, EstimatorType type, int window);
+        void reset();
+
+    private:
+        void publish(const TelemetrySnapshot &next);
+
+        TelemetrySnapshot buffers[2];
+        std::atomic<quint64> versions[2];
+        std::atomic<quint64> published;
+        //requested by other threads, picked up by the sampler
+        std::atomic<int> estimatorType[2];
+        std::atomic<int> estimatorWindow[2];
+        std::atomic<bool> resetRequested;
+        //sampler-private
+        VelocityEstimator estimators[2];
+};
+
+#endif // TELEMETRY_H
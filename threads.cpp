@@ -0,0 +1,299 @@
+#include "threads.h"
+#include "trace.h"
+#include <cmath>
+#include <limits>
+#include <QMutexLocker>
+
+Scheduler::Scheduler(QObject *parent) : QThread(parent)
+{
+    setObjectName("Scheduler");
+    clock.start();
+    //server, two corrections and a write may block for long, the periodic jobs still get a thread
+    pool.setMaxThreadCount(8);
+    start();
+}
+
+Scheduler::~Scheduler()
+{
+    stop();
+    pool.waitForDone();
+}
+
+int Scheduler::insert(QString name, Entry entry)
+{
+    QMutexLocker locker(&mutex);
+    int id = ++lastId;
+    entry.stats.id = id;
+    entry.stats.name = name;
+    entry.stats.interval_ms = entry.interval_ns / 1000000;
+    entry.traceName = Trace::intern(name);
+    if(entry.context != nullptr && !contexts.contains(entry.context))
+    {
+        contexts.insert(entry.context);
+        connect(entry.context, &QObject::destroyed, this, [ = ] (QObject *context)
+        {
+            forgetContext(context);
+        }, Qt::DirectConnection);
+    }
+    jobs.insert(id, entry);
+    wake.wakeOne();
+    return id;
+}
+
+int Scheduler::addPeriodic(QString name, int interval_ms, Job job, QObject *context, bool enabled)
+{
+    Entry entry;
+    entry.job = job;
+    entry.context = context;
+    entry.interval_ns = (qint64)qMax(1, interval_ms) * 1000000;
+    entry.deadline_ns = clock.nsecsElapsed();
+    entry.periodic = true;
+    entry.enabled = enabled;
+    return insert(name, entry);
+}
+
+int Scheduler::addOneShot(QString name, int delay_ms, Job job, QObject *context)
+{
+    Entry entry;
+    entry.job = job;
+    entry.context = context;
+    entry.deadline_ns = clock.nsecsElapsed() + (qint64)qMax(0, delay_ms) * 1000000;
+    entry.enabled = true;
+    return insert(name, entry);
+}
+
+int Scheduler::runBlocking(QString name, Job job)
+{
+    Entry entry;
+    entry.job = job;
+    entry.inFlight = true;
+    entry.stats.runs = 1;
+    int id = insert(name, entry);
+    const char *traceName = Trace::intern(name);
+    pool.start(new JobRunnable([ = ]()
+    {
+        TRACE_SCOPE(traceName);
+        qint64 started = clock.nsecsElapsed();
+        job();
+        complete(id, started);
+    }));
+    return id;
+}
+
+void Scheduler::setEnabled(int id, bool enabled)
+{
+    QMutexLocker locker(&mutex);
+    if(!jobs.contains(id))
+        return;
+    Entry &entry = jobs[id];
+    if(enabled && !entry.enabled)
+        entry.deadline_ns = clock.nsecsElapsed();
+    entry.enabled = enabled;
+    wake.wakeOne();
+}
+
+void Scheduler::setInterval(int id, int interval_ms)
+{
+    QMutexLocker locker(&mutex);
+    if(!jobs.contains(id))
+        return;
+    Entry &entry = jobs[id];
+    entry.interval_ns = (qint64)qMax(1, interval_ms) * 1000000;
+    entry.stats.interval_ms = interval_ms;
+    if(!entry.inFlight)
+        entry.deadline_ns = qMin(entry.deadline_ns, clock.nsecsElapsed() + entry.interval_ns);
+    wake.wakeOne();
+}
+
+void Scheduler::trigger(int id)
+{
+    QMutexLocker locker(&mutex);
+    if(!jobs.contains(id))
+        return;
+    jobs[id].deadline_ns = clock.nsecsElapsed();
+    wake.wakeOne();
+}
+
+void Scheduler::remove(int id)
+{
+    QMutexLocker locker(&mutex);
+    if(!jobs.contains(id))
+        return;
+    if(jobs[id].inFlight)
+    {
+        jobs[id].removed = true;
+        jobs[id].enabled = false;
+    }
+    else
+        jobs.remove(id);
+}
+
+bool Scheduler::isPending(int id)
+{
+    QMutexLocker locker(&mutex);
+    return jobs.contains(id);
+}
+
+Scheduler::JobStats Scheduler::stats(int id)
+{
+    QMutexLocker locker(&mutex);
+    if(!jobs.contains(id))
+        return JobStats();
+    return jobs[id].stats;
+}
+
+QList<Scheduler::JobStats> Scheduler::allStats()
+{
+    QMutexLocker locker(&mutex);
+    QList<JobStats> list;
+    for(auto it = jobs.constBegin(); it != jobs.constEnd(); ++it)
+        list.append(it->stats);
+    return list;
+}
+
+void Scheduler::stop()
+{
+    mutex.lock();
+    stopping = true;
+    wake.wakeAll();
+    mutex.unlock();
+    QThread::wait();
+    pool.waitForDone();
+}
+
+void Scheduler::run()
+{
+    mutex.lock();
+    while(!stopping)
+    {
+        int due = -1;
+        qint64 deadline = std::numeric_limits<qint64>::max();
+        for(auto it = jobs.constBegin(); it != jobs.constEnd(); ++it)
+        {
+            if(!it->enabled || it->inFlight)
+                continue;
+            if(it->deadline_ns < deadline)
+            {
+                deadline = it->deadline_ns;
+                due = it.key();
+            }
+        }
+        if(due < 0)
+        {
+            //nothing to do: park until a job gets added, enabled or triggered
+            wake.wait(&mutex);
+            continue;
+        }
+        qint64 now = clock.nsecsElapsed();
+        if(deadline > now)
+        {
+            wake.wait(&mutex, (unsigned long)((deadline - now + 999999) / 1000000));
+            continue;
+        }
+        Entry &entry = jobs[due];
+        entry.inFlight = true;
+        account(&entry, (double)(now - deadline) / 1000000.0);
+        Job job = entry.job;
+        QObject *context = entry.context;
+        const char *traceName = entry.traceName;
+        if(context != nullptr)
+        {
+            //posted under the lock, forgetContext() holds a destroyed context until the event is queued
+            dispatch(due, job, context, traceName);
+            continue;
+        }
+        mutex.unlock();
+        dispatch(due, job, context, traceName);
+        mutex.lock();
+    }
+    mutex.unlock();
+}
+
+void Scheduler::dispatch(int id, Job job, QObject *context, const char *traceName)
+{
+    if(context != nullptr)
+    {
+        QMetaObject::invokeMethod(context, [ = ]()
+        {
+            TRACE_SCOPE(traceName);
+            qint64 started = clock.nsecsElapsed();
+            job();
+            complete(id, started);
+        }, Qt::QueuedConnection);
+    }
+    else
+    {
+        //the job is in flight until it completes, a periodic one never overlaps itself
+        pool.start(new JobRunnable([ = ]()
+        {
+            TRACE_SCOPE(traceName);
+            qint64 started = clock.nsecsElapsed();
+            job();
+            complete(id, started);
+        }));
+    }
+}
+
+void Scheduler::complete(int id, qint64 started_ns)
+{
+    mutex.lock();
+    if(!jobs.contains(id))
+    {
+        mutex.unlock();
+        return;
+    }
+    Entry &entry = jobs[id];
+    qint64 now = clock.nsecsElapsed();
+    entry.stats.lastDuration_ms = (double)(now - started_ns) / 1000000.0;
+    entry.stats.maxDuration_ms = fmax(entry.stats.maxDuration_ms, entry.stats.lastDuration_ms);
+    entry.inFlight = false;
+    if(entry.removed || !entry.periodic)
+    {
+        jobs.remove(id);
+        mutex.unlock();
+        emit jobFinished(id);
+        return;
+    }
+    //keep the deadline grid, dropping the periods we overran
+    entry.deadline_ns += entry.interval_ns;
+    while(entry.deadline_ns <= now)
+    {
+        entry.deadline_ns += entry.interval_ns;
+        entry.stats.skipped++;
+    }
+    wake.wakeOne();
+    mutex.unlock();
+}
+
+void Scheduler::forgetContext(QObject *context)
+{
+    QList<int> dropped;
+    mutex.lock();
+    contexts.remove(context);
+    for(auto it = jobs.begin(); it != jobs.end();)
+    {
+        if(it->context == context)
+        {
+            //a run in flight was queued to the context and is discarded with it
+            dropped.append(it.key());
+            it = jobs.erase(it);
+        }
+        else
+            ++it;
+    }
+    mutex.unlock();
+    for(int id : dropped)
+        emit jobFinished(id);
+}
+
+void Scheduler::account(Entry *entry, double lateness_ms)
+{
+    JobStats *stats = &entry->stats;
+    stats->runs++;
+    stats->lastLateness_ms = lateness_ms;
+    stats->maxLateness_ms = fmax(stats->maxLateness_ms, lateness_ms);
+    double delta = lateness_ms - stats->meanLateness_ms;
+    stats->meanLateness_ms += delta / stats->runs;
+    entry->lateness_m2 += delta * (lateness_ms - stats->meanLateness_ms);
+    stats->jitter_ms = sqrt(entry->lateness_m2 / stats->runs);
+}
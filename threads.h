@@ -26,86 +26,114 @@
 #ifndef THREADS_H
 #define THREADS_H
 
-#include <cmath>
+#include <functional>
 #include <QThread>
-#include <QTimer>
-#include <QEventLoop>
-#include <QDateTime>
-#include <QWidget>
+#include <QThreadPool>
+#include <QRunnable>
 #include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QMap>
+#include <QList>
+#include <QSet>
+#include <QString>
 
-class Thread : public QThread
+///Pool task running a function, deleted by the pool when done
+class JobRunnable : public QRunnable
 {
-        Q_OBJECT
-    private:
-        QObject* parent;
-        QMutex mutex;
-        int next_ms;
-        int timer_ms;
-        int loop_ms;
-        QString Name;
     public:
-        Thread(QObject* p, int timer = 20, int loop = 20, QString n = "") : QThread()
-        {
-            parent = p;
-            timer_ms = timer;
-            loop_ms = loop;
-            next_ms = timer_ms;
-            Name = n;
-        }
-        void run()
-        {
-            lastPollTime = QDateTime::currentDateTimeUtc();
-            while(!isInterruptionRequested())
-            {
-                lastPollTime = QDateTime::currentDateTimeUtc();
-                next_ms = loop_ms;
-                if(lock())
-                {
-                    emit threadLoop(this);
-                    QThread::msleep(next_ms);
-                }
-            }
-        }
-        void stop()
-        {
-            requestInterruption();
-            next_ms = timer_ms;
-        }
-        bool lock()
-        {
-            return mutex.tryLock(loop_ms);
-        }
-        void unlock()
-        {
-            mutex.unlock();
-        }
-        void setTimer(int timer)
-        {
-            timer_ms = timer;
-        }
-        void setLoop(int loop)
+        JobRunnable(std::function<void()> f) : QRunnable(), fn(f)
         {
-            loop_ms = loop;
+            setAutoDelete(true);
         }
-        QString getName()
+        void run() override
         {
-            return Name;
-        }
-        void block(int msec) {
-            QTimer timer;
-            timer.setSingleShot(true);
-            QEventLoop loop;
-            connect(&timer, SIGNAL(timeout()), &loop, SLOT(quit()));
-            connect(this, SIGNAL(finished()), &loop, SLOT(quit()));
-            timer.start(msec);
-            loop.exec();
+            fn();
         }
-        QObject *getParent() { return parent; }
     private:
-        QDateTime lastPollTime;
+        std::function<void()> fn;
+};
+
+///Single reactor thread running periodic and one-shot jobs on monotonic deadlines.
+///When no job is due the thread parks on a wait condition without waking up.
+///The reactor only dispatches: jobs run on their context thread or on a private
+///pool, so a job blocked on the link never delays the deadlines of the others.
+class Scheduler : public QThread
+{
+        Q_OBJECT
+    public:
+        typedef std::function<void()> Job;
+        struct JobStats
+        {
+            int id { -1 };
+            QString name;
+            qint64 interval_ms { 0 };
+            quint64 runs { 0 };
+            quint64 skipped { 0 };
+            double lastLateness_ms { 0.0 };
+            double maxLateness_ms { 0.0 };
+            double meanLateness_ms { 0.0 };
+            double jitter_ms { 0.0 };
+            double lastDuration_ms { 0.0 };
+            double maxDuration_ms { 0.0 };
+        };
+
+        Scheduler(QObject *parent = nullptr);
+        ~Scheduler();
+
+        ///Run job every interval_ms, on the context thread if one is given, on the pool otherwise
+        int addPeriodic(QString name, int interval_ms, Job job, QObject *context = nullptr, bool enabled = true);
+        ///Run job once after delay_ms, on the context thread if one is given, on the pool otherwise
+        int addOneShot(QString name, int delay_ms, Job job, QObject *context = nullptr);
+        ///Run a job that may block for a long time on a dedicated worker
+        int runBlocking(QString name, Job job);
+        void setEnabled(int id, bool enabled);
+        void setInterval(int id, int interval_ms);
+        void trigger(int id);
+        void remove(int id);
+        bool isPending(int id);
+        JobStats stats(int id);
+        QList<JobStats> allStats();
+        ///Stop dispatching and wait for the jobs running on the pool
+        void stop();
+
     signals:
-        void threadLoop(Thread *);
+        void jobFinished(int id);
+
+    protected:
+        void run() override;
+
+    private:
+        struct Entry
+        {
+            Job job;
+            ///span name of the job when tracing
+            const char *traceName { nullptr };
+            QObject *context { nullptr };
+            qint64 interval_ns { 0 };
+            qint64 deadline_ns { 0 };
+            bool periodic { false };
+            bool enabled { false };
+            bool inFlight { false };
+            bool removed { false };
+            double lateness_m2 { 0.0 };
+            JobStats stats;
+        };
+        int insert(QString name, Entry entry);
+        void dispatch(int id, Job job, QObject *context, const char *traceName);
+        void complete(int id, qint64 started_ns);
+        void account(Entry *entry, double lateness_ms);
+        ///Drop the jobs of a context being destroyed, their queued runs never happen
+        void forgetContext(QObject *context);
+
+        QMutex mutex;
+        QWaitCondition wake;
+        QElapsedTimer clock;
+        QThreadPool pool;
+        QMap<int, Entry> jobs;
+        QSet<QObject *> contexts;
+        int lastId { 0 };
+        bool stopping { false };
 };
 
 #endif // THREADS_H
@@ -0,0 +1,207 @@
+#include "trace.h"
+#include <chrono>
+#include <cstring>
+#include <QCoreApplication>
+#include <QDir>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QSet>
+#include <QThread>
+
+#define TRACE_CAPACITY 65536
+
+namespace
+{
+struct Event
+{
+    const char *name;
+    qint64 begin;
+    qint64 end;
+};
+
+///Written by its own thread only, read by the exporter
+struct ThreadBuffer
+{
+    int tid;
+    QString name;
+    Event ring[TRACE_CAPACITY];
+    std::atomic<quint64> head { 0 };
+    ///first event of the current session, owned by the exporter
+    quint64 base { 0 };
+};
+
+QMutex registryMutex;
+QList<ThreadBuffer *> registry;
+///buffers of exited threads, handed to the next threads that record
+QList<ThreadBuffer *> spare;
+QSet<QByteArray> names;
+QString filename;
+std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+///Gives the buffer back when its thread exits, pool threads come and go
+///and the registry only grows to the most threads recording at once
+struct LocalBuffer
+{
+    ThreadBuffer *buffer { nullptr };
+    ~LocalBuffer()
+    {
+        if(buffer == nullptr)
+            return;
+        QMutexLocker locker(&registryMutex);
+        spare.append(buffer);
+    }
+};
+thread_local LocalBuffer local;
+
+ThreadBuffer *threadBuffer()
+{
+    if(local.buffer == nullptr)
+    {
+        QThread *thread = QThread::currentThread();
+        QMutexLocker locker(&registryMutex);
+        ThreadBuffer *buffer;
+        if(!spare.isEmpty())
+        {
+            //keeps its tid and the events not exported yet, the threads never overlapped
+            buffer = spare.takeLast();
+        }
+        else
+        {
+            buffer = new ThreadBuffer();
+            buffer->tid = registry.count() + 1;
+            registry.append(buffer);
+        }
+        if(QCoreApplication::instance() && thread == QCoreApplication::instance()->thread())
+            buffer->name = "Main";
+        else if(thread && !thread->objectName().isEmpty())
+            buffer->name = thread->objectName();
+        else
+            buffer->name = "Thread " + QString::number(buffer->tid);
+        local.buffer = buffer;
+    }
+    return local.buffer;
+}
+
+QString escape(QString text)
+{
+    QString s;
+    for(QChar c : text)
+    {
+        if(c == '\\' || c == '"')
+            s += QString("\\") + c;
+        //control characters are not allowed in JSON strings
+        else if(c.unicode() < 0x20)
+            s += QString("\\u%1").arg(c.unicode(), 4, 16, QChar('0'));
+        else
+            s += c;
+    }
+    return s;
+}
+}
+
+std::atomic<bool> Trace::active(false);
+
+qint64 Trace::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Trace::record(const char *name, qint64 begin_ns, qint64 end_ns)
+{
+    ThreadBuffer *buffer = threadBuffer();
+    quint64 index = buffer->head.load(std::memory_order_relaxed);
+    Event &e = buffer->ring[index % TRACE_CAPACITY];
+    e.name = name;
+    e.begin = begin_ns;
+    e.end = end_ns;
+    buffer->head.store(index + 1, std::memory_order_release);
+}
+
+const char *Trace::intern(QString name)
+{
+    QMutexLocker locker(&registryMutex);
+    QByteArray utf8 = name.toUtf8();
+    auto it = names.insert(utf8);
+    return it->constData();
+}
+
+void Trace::start(QString file)
+{
+    {
+        QMutexLocker locker(&registryMutex);
+        filename = file;
+        //skip what was recorded by an earlier session
+        for(ThreadBuffer *buffer : registry)
+            buffer->base = buffer->head.load(std::memory_order_acquire);
+    }
+    active.store(true, std::memory_order_release);
+}
+
+bool Trace::stop()
+{
+    if(!active.exchange(false))
+        return true;
+    QMutexLocker locker(&registryMutex);
+    QByteArray json = "{\"traceEvents\":[\n";
+    bool first = true;
+    qint64 pid = QCoreApplication::applicationPid();
+    for(ThreadBuffer *buffer : registry)
+    {
+        json += QString("%1{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%2,\"tid\":%3,\"args\":{\"name\":\"%4\"}}")
+                .arg(first ? "" : ",\n").arg(pid).arg(buffer->tid).arg(escape(buffer->name)).toUtf8();
+        first = false;
+        quint64 head = buffer->head.load(std::memory_order_acquire);
+        quint64 tail = qMax(buffer->base, head > TRACE_CAPACITY ? head - TRACE_CAPACITY : 0);
+        QList<Event> events;
+        for(quint64 i = tail; i < head; i++)
+            events.append(buffer->ring[i % TRACE_CAPACITY]);
+        //a span still closing on its thread may have recycled the oldest slots meanwhile
+        quint64 after = buffer->head.load(std::memory_order_acquire);
+        int stale = after > TRACE_CAPACITY && after - TRACE_CAPACITY > tail ? (int)(after - TRACE_CAPACITY - tail) : 0;
+        for(int i = stale; i < events.count(); i++)
+        {
+            const Event &e = events[i];
+            json += QString(",\n{\"name\":\"%1\",\"cat\":\"gt\",\"ph\":\"X\",\"ts\":%2,\"dur\":%3,\"pid\":%4,\"tid\":%5}")
+                    .arg(escape(e.name)).arg(e.begin / 1000.0, 0, 'f', 3).arg((e.end - e.begin) / 1000.0, 0, 'f', 3)
+                    .arg(pid).arg(buffer->tid).toUtf8();
+        }
+    }
+    json += "\n]}\n";
+    QSaveFile out(filename);
+    if(!out.open(QIODevice::WriteOnly))
+        return false;
+    if(out.write(json) != json.length())
+    {
+        out.cancelWriting();
+        return false;
+    }
+    return out.commit();
+}
+
+bool Trace::toggle(QString file)
+{
+    if(enabled())
+    {
+        stop();
+        return false;
+    }
+    start(file);
+    return true;
+}
+
+void Trace::startFromEnvironment()
+{
+    QString file = QString::fromLocal8Bit(qgetenv("GT_TRACE"));
+    if(!file.isEmpty())
+        start(file);
+}
+
+QString Trace::fileName()
+{
+    QMutexLocker locker(&registryMutex);
+    if(filename.isEmpty())
+        return QDir::tempPath() + "/gt-configurator-trace.json";
+    return filename;
+}
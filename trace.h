@@ -0,0 +1,62 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <QString>
+
+///Span tracing exported as Chrome/Perfetto trace-event JSON.
+///Every thread records into its own ring buffer with a single writer and no
+///locks, a disabled tracer costs one relaxed atomic load per span.
+///Setting GT_TRACE=<file> in the environment starts tracing at startup.
+namespace Trace
+{
+extern std::atomic<bool> active;
+
+inline bool enabled()
+{
+    return active.load(std::memory_order_relaxed);
+}
+///Start recording, the trace is written to filename by stop()
+void start(QString filename);
+///Stop recording and write the trace, returns false on I/O errors
+bool stop();
+///Start or stop, returns whether tracing is now active
+bool toggle(QString filename);
+///Start if GT_TRACE is set
+void startFromEnvironment();
+QString fileName();
+///Stable copy of name usable as span name for the lifetime of the process
+const char *intern(QString name);
+///Nanoseconds on the trace clock
+qint64 now();
+///Record a complete span on the calling thread
+void record(const char *name, qint64 begin_ns, qint64 end_ns);
+}
+
+class TraceScope
+{
+    public:
+        TraceScope(const char *name)
+        {
+            label = name;
+            begin = Trace::enabled() ? Trace::now() : -1;
+        }
+        ~TraceScope()
+        {
+            if(begin >= 0)
+                Trace::record(label, begin, Trace::now());
+        }
+
+    private:
+        const char *label;
+        qint64 begin;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+///Trace the enclosing scope, name must outlive the process (literal or interned)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+///Trace a single call within an expression, the span is named after the call text
+#define TRACED(call) ([&]() -> decltype(call) { TRACE_SCOPE(#call); return call; }())
+
+#endif // TRACE_H
@@ -1,7 +1,7 @@
 #!/bin/bash
 url=$1
 curl --resolve "iliaplatone.com:443:192.71.211.119" "${url}?product=gt*" | jq .data | tr -d '"' | base64 -d | tr -s ',' '\n' | cut -d '/' -f 2 | cut -d '-' -f 1 | while read line; do curl --resolve "iliaplatone.com:443:192.71.211.119" "${url}?product=$line&download=on" -o $line.json; done
-i=1
+#the firmware is packed into firmware.bundle by gt-firmware-pack at build time
 echo "IDI_ICON1               ICON        DISCARDABLE            \"icon.ico\"
 IDI_ICON2               ICON        DISCARDABLE            \"check.ico\"" > app.rc
 
@@ -10,12 +10,4 @@ echo "<RCC>
         <file>icon.ico</file>
         <file>check.ico</file>
     </qresource>
-    <qresource prefix=\"/data\">" > resource.qrc
-for file in *.json; do echo "<file>"$file"</file>" >> resource.qrc;
-echo "IDI_DATA$i               TEXT        DISCARDABLE            \"$file\"" >> app.rc
-i=$(($i+1))
-done
-echo "
-</qresource>
-</RCC>
-" >> resource.qrc
+</RCC>" > resource.qrc